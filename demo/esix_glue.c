@@ -29,6 +29,7 @@
 #include <FreeRTOS.h>
 #include "task.h"
 #include "queue.h"
+#include "semphr.h"
 #include "types.h"
 #include <esix.h>
 #include "mmap.h"
@@ -37,6 +38,10 @@
 
 int alloc_count=0;
 
+//one binary semaphore per socket for the blocking socket calls, and one for poll().
+//esix tells how many, the array is allocated on first use.
+static xSemaphoreHandle *esix_sems;
+
 void *esix_w_malloc(size_t size)
 {
 	int i;
@@ -79,3 +84,46 @@ void esix_w_send_packet(u16_t lla[3], void *packet, int len)
 
 	xQueueSend(ether_send_queue, &eth_f, portMAX_DELAY);	
 }
+
+//creates the semaphore of a socket the first time it's needed
+static xSemaphoreHandle esix_w_sem(int socket)
+{
+	int i, n = esix_sem_count();
+
+	if(socket < 0 || socket >= n)
+		return NULL;
+
+	vTaskSuspendAll();
+	if(esix_sems == NULL && (esix_sems = pvPortMalloc(n * sizeof(xSemaphoreHandle))) != NULL)
+		for(i = 0; i < n; i++)
+			esix_sems[i] = NULL;
+
+	if(esix_sems != NULL && esix_sems[socket] == NULL)
+	{
+		vSemaphoreCreateBinary(esix_sems[socket]);
+		//it's created available, take that back
+		if(esix_sems[socket] != NULL)
+			xSemaphoreTake(esix_sems[socket], 0);
+	}
+	xTaskResumeAll();
+
+	return esix_sems != NULL ? esix_sems[socket] : NULL;
+}
+
+int esix_w_sem_wait(int socket, u32_t timeout)
+{
+	xSemaphoreHandle sem;
+
+	if((sem = esix_w_sem(socket)) == NULL)
+		return 0;
+
+	return xSemaphoreTake(sem, timeout ? timeout / portTICK_RATE_MS : portMAX_DELAY) == pdTRUE;
+}
+
+void esix_w_sem_signal(int socket)
+{
+	xSemaphoreHandle sem;
+
+	if((sem = esix_w_sem(socket)) != NULL)
+		xSemaphoreGive(sem);
+}
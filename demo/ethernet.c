@@ -168,15 +168,14 @@ void ether_handler()
 
 /**
  * ether_frame_received : called after an interrupt has been received.
- * copies a frame from the RX ring buffer to a loacl buffer.
+ * copies a frame from the RX ring buffer to a buffer handed over to esix.
  * 
  */
 void ether_receive_task(void *param)
 {
 	int i;
 	int len;
-	static char buf[MAX_FRAME_SIZE];
-	u32_t *eth_buf = (u32_t *) buf;
+	u32_t *eth_buf = NULL;
 	struct ether_hdr_t hdr;
 	
 	while(1)
@@ -190,7 +189,8 @@ void ether_receive_task(void *param)
 		len =	hdr.FRAME_LENGTH - 20;
 		
 		// we process the packet only if it's not too big and if it contains IPv6
-		if((len > MAX_FRAME_SIZE - 20) || (hdr.ETHERTYPE != 0xdd86))
+		if((len > MAX_FRAME_SIZE - 20) || (hdr.ETHERTYPE != 0xdd86) ||
+			(eth_buf = esix_w_malloc(len + 3)) == NULL)
 		{
 			i=0;
 			while(i++ < len)
@@ -200,10 +200,10 @@ void ether_receive_task(void *param)
 		{	
 			// read the payload
 			for(i = 0; i < len; i += 4)
-				*(eth_buf+4+i/4) = ETH0->MACDATA;
+				*(eth_buf+i/4) = ETH0->MACDATA;
 				
-			//got a v6 frame, pass it to the v6 stack
-			esix_ip_process((eth_buf + 4), len);
+			//got a v6 frame, pass it to the v6 stack, which frees it
+			esix_ip_process_buf(eth_buf, len);
 		}
 		
 		// read checksum
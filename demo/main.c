@@ -42,8 +42,8 @@ void http_server_task(void *param);
 void tcp_server_task(void *param);
 void tcp_chargen_task(void *param);
 void udp_server_task(void *param);
-void udp_echo_task(void *param);
 void mdns_server_task(void *param);
+void tcp_echo_init(void);
 
 extern struct esix_ipaddr_table_row *addrs;
 
@@ -68,6 +68,7 @@ void main(void)
 	lla[1] = HTON16(lla[1]);
 	lla[2] = HTON16(lla[2]);
 	esix_init(lla);
+	tcp_echo_init();
 	
 	// FreeRTOS tasks scheduling
 	xTaskCreate(main_task, (signed char *) "main", 200, NULL, tskIDLE_PRIORITY + 1, NULL);
@@ -75,7 +76,6 @@ void main(void)
 	xTaskCreate(tcp_server_task, (signed char *) "tcp server", 200, NULL, tskIDLE_PRIORITY + 1, NULL);
 	xTaskCreate(tcp_chargen_task, (signed char *) "tcp server", 200, NULL, tskIDLE_PRIORITY + 1, NULL);
 	xTaskCreate(udp_server_task, (signed char *) "udp server", 200, NULL, tskIDLE_PRIORITY + 1, NULL);
-	xTaskCreate(udp_echo_task, (signed char *) "udp echo server", 200, NULL, tskIDLE_PRIORITY + 1, NULL);
 	xTaskCreate(mdns_server_task, (signed char *) "mdns server", 200, NULL, tskIDLE_PRIORITY + 1, NULL);
 	vTaskStartScheduler();
 }
@@ -87,66 +87,109 @@ void vApplicationStackOverflowHook(xTaskHandle *pxTask, signed portCHAR *pcTaskN
 
 void main_task(void *param)
 {	
+	int ticks = 0;
+	const u16_t tick = esix_tick_ms();
 	while(1)
 	{
 		//uart_printf("task stack %x\n", uxTaskGetStackHighWaterMark(NULL));
-		vTaskDelay(1000);
-		esix_periodic_callback();
+		vTaskDelay(tick / portTICK_RATE_MS);
+		esix_tick_callback();
+
+		if(++ticks == 1000/tick)
+		{
+			ticks = 0;
+			esix_periodic_callback();
+		}
 	}
 }
 
+/**
+ * Serves both the led control (port 2009) and the echo (port 7) udp
+ * services, out of a single task.
+ */
 void udp_server_task(void *param)
 {
 	static char buff[100];
-	int soc;
+	void *data;
+	int nbread;
+	struct pollfd fds[2];
 	struct sockaddr_in6 from, to;
 	int sockaddrlen = sizeof(struct sockaddr_in6);
 	
-	to.sin6_port = HTON16(2009);
 	to.sin6_addr = in6addr_any;
-	
-	soc = socket(AF_INET6, SOCK_DGRAM, 0);
-	bind(soc, &to, sockaddrlen);
-	listen(soc, 1);
+
+	to.sin6_port = HTON16(2009);
+	fds[0].fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	fds[0].events = POLLIN;
+	bind(fds[0].fd, &to, sockaddrlen);
+	listen(fds[0].fd, 1);
+
+	to.sin6_port = HTON16(7);
+	if((fds[1].fd = socket(AF_INET6, SOCK_DGRAM, 0)) <0)
+		uart_printf("socket failed");
+	fds[1].events = POLLIN;
+	if(bind(fds[1].fd, &to, sockaddrlen) < 0)
+		uart_printf("bind failed");
+	if(listen(fds[1].fd, 1) <0)
+		uart_printf("listen failed");
 		
 	while(1)
 	{
-		vTaskDelay(100);
-		if(recvfrom(soc, buff, 99, 0, &from, &sockaddrlen) <= 0)
+		if(poll(fds, 2, -1) <= 0)
 			continue;
-		if(strncmp(buff, "toggle_led\n", 11))
-			sendto(soc, "commands : toggle_led\n", 22, 0, &from, sizeof(struct sockaddr_in6));
-		else
+
+		if((fds[0].revents & POLLIN) &&
+			recvfrom(fds[0].fd, buff, 99, MSG_DONTWAIT, &from, &sockaddrlen) > 0)
+		{
+			if(strncmp(buff, "toggle_led\n", 11))
+				sendto(fds[0].fd, "commands : toggle_led\n", 22, 0, &from, sizeof(struct sockaddr_in6));
+			else
+			{
+				sendto(fds[0].fd, "status led toggled.\n", 20, 0, &from, sizeof(struct sockaddr_in6));
+				GPIOF->DATA[1]	^= 1;
+			}
+		}
+
+		//echo the datagram straight out of the frame it came in
+		if(fds[1].revents & POLLIN)
 		{
-			sendto(soc, "status led toggled.\n", 20, 0, &from, sizeof(struct sockaddr_in6));
-			GPIOF->DATA[1]	^= 1;
+			nbread = recv_zc(fds[1].fd, &data, &from, MSG_DONTWAIT);
+			if(data != NULL)
+				sendto(fds[1].fd, data, nbread, 0, &from, sizeof(struct sockaddr_in6));
+			release(data);
 		}
 	}
 }
 
-void udp_echo_task(void *param)
+static void tcp_echo_recv(int conn, const void *data, int len, const struct sockaddr_in6 *from, void *arg)
 {
-	static char buff[100];
-	int soc, nbread;
-	struct sockaddr_in6 from, to;
-	int sockaddrlen = sizeof(struct sockaddr_in6);
-	
-	to.sin6_port = HTON16(7);
-	to.sin6_addr = in6addr_any;
-	
-	if((soc = socket(AF_INET6, SOCK_DGRAM, 0)) <0)
-		uart_printf("socket failed");
-	if(bind(soc, &to, sockaddrlen) < 0)
-		uart_printf("bind failed");
-	if(listen(soc, 1) <0)
-		uart_printf("listen failed");
-		
-	while(1)
-	{
-		vTaskDelay(50);
-		if((nbread = recvfrom(soc, buff, 99, 0, &from, &sockaddrlen)) >0)
-			sendto(soc, buff, nbread, 0, &from, sizeof(struct sockaddr_in6));
-	}
+	if(data == NULL)
+		close(conn);
+	else
+		send(conn, data, len, MSG_DONTWAIT);
+}
+
+static const struct sock_callbacks tcp_echo_callbacks = {
+	.on_recv = tcp_echo_recv,
+};
+
+/**
+ * TCP echo service (port 7), run by the stack itself through callbacks :
+ * no task, connections get the callbacks of the listening socket.
+ */
+void tcp_echo_init(void)
+{
+	int soc;
+	struct sockaddr_in6 serv;
+
+	serv.sin6_port = HTON16(7);
+	serv.sin6_addr = in6addr_any;
+
+	if((soc = socket(AF_INET6, SOCK_STREAM, 0)) <0 ||
+		bind(soc, &serv, sizeof(struct sockaddr_in6)) <0 ||
+		listen(soc, 4) <0 ||
+		set_callbacks(soc, &tcp_echo_callbacks, NULL) <0)
+		uart_printf("tcp_echo : setup failed\n");
 }
 
 void tcp_server_task(void *param)
@@ -168,7 +211,6 @@ void tcp_server_task(void *param)
 
 	while(1)
 	{
-		vTaskDelay(500);
 		if((conn = accept(soc, NULL, NULL)) <0)
 			continue;
 
@@ -177,7 +219,6 @@ void tcp_server_task(void *param)
 		
 		while(1)
 		{
-			vTaskDelay(100);
 			if((len = recv(conn, buff, 99, 0)) <0)
 				break;
 
@@ -227,17 +268,14 @@ void tcp_chargen_task(void *param)
 
 	while(1)
 	{
-		vTaskDelay(500);
 		if((conn = accept(soc, NULL, NULL)) <0)
 			continue;
 
 		send(conn, "chargen starting...\n", 21, 0);
-		vTaskDelay(200);
 		
 		while(1)
 		{
-			vTaskDelay(2);
-			if((send(conn, buff, 1398, 0))<0)
+			if((send(conn, buff, 1398, 0))<=0)
 				break;
 		}
 		close(conn);
@@ -264,15 +302,12 @@ void http_server_task(void *param)
 		
 	while(1)
 	{
-		//remember all our socket primitives are
-		//nonblocking for now
-		vTaskDelay(500);
+		//accept() and recv() block until there's something to do
 		if((conn = accept(soc, NULL, NULL)) <0)
 			continue;
 
 		while(1)
 		{
-			vTaskDelay(50);
 			if((len = recv(conn, buff, 799, 0)) <0)
 				break;
 
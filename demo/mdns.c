@@ -10,9 +10,10 @@ void mdns_server_task(void *param)
 	//it at all...) 
 
 	static char buff[256];
-	int soc, nbread, i;
+	int soc, nbread, i, on = 1;
 	struct sockaddr_in6 from, to;
 	struct ip6_addr mcast;
+	struct ipv6_mreq mreq;
 	
 	int sockaddrlen = sizeof(struct sockaddr_in6);
 	struct dns r;
@@ -23,12 +24,10 @@ void mdns_server_task(void *param)
 
 		vTaskDelay(600);
 
-	//ok this is plain wrong, but needed to receive multicast traffic
 	mcast.addr1 = hton32(0xff020000);
 	mcast.addr2 = 0;
 	mcast.addr3 = 0;
 	mcast.addr4 = hton32(0xfb);
-	esix_intf_add_address(&mcast, 0x80, 0, MULTICAST); 
 
 	//grab an address
 	if((i=esix_intf_get_type_address(GLOBAL)) < 0)
@@ -37,11 +36,19 @@ void mdns_server_task(void *param)
 
 	if((soc = socket(AF_INET6, SOCK_DGRAM, 0)) <0)
 		uart_printf("mdns task : socket failed\n");
+	//other tasks can listen to mDNS as well
+	setsockopt(soc, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
 	if(bind(soc, &to, sockaddrlen) < 0)
 		uart_printf("mdns task : bind failed\n");
 	if(listen(soc, 1) <0)
 		uart_printf("mdns task : listen failed\n");
 
+	//receive the ff02::fb group traffic (this sends an MLD report)
+	esix_memcpy(&mreq.ipv6mr_multiaddr, &mcast, 16);
+	mreq.ipv6mr_interface = 0;
+	if(setsockopt(soc, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq)) < 0)
+		uart_printf("mdns task : join failed\n");
+
 	to.sin6_port = hton16(5353);
 	esix_memcpy(&to.sin6_addr, &mcast, 16);
 
@@ -61,7 +68,6 @@ void mdns_server_task(void *param)
 		
 	while(1)
 	{
-		vTaskDelay(400);
 		if((nbread = recvfrom(soc, buff, 255, 0, &from, &sockaddrlen)) <= 0)
 			continue;
 		
@@ -33,13 +33,29 @@
 #define ESIX_MAX_RT	8 	//max number of routes the node can have
 #define ESIX_MAX_NB 16 //max number of neighbors in the table
 #define ESIX_MAX_SOCK 32 //max number of sockets
-#define FIRST_PORT 32000 //make sure that ESIX_MAX_SOCK < LAST_PORT - FIRST_PORT
-#define LAST_PORT  65535 //or mayhem will happen
-#define ESIX_QUEUE_DEPHT 5 //per-socket packet queue depht (received + send (for tcp))
+#define ESIX_SOCK_HASH 16 //buckets of the socket lookup tables, must be a power of 2
+#define FIRST_PORT 32000 //ephemeral port range, socket() picks one at random in it
+#define LAST_PORT  65535 //(RFC 6056)
+#define ESIX_MAX_MSHIP 8 //max number of multicast group memberships (IPV6_JOIN_GROUP), all sockets together
+#define ESIX_UDP_RCVBUF 4096 //default udp receive queue size (datagram bytes), at most 65535
+#define ESIX_OOO_DEPHT 4 //per-socket out-of-order intervals kept (tcp reassembly, SACK scoreboard)
+#define ESIX_SNDBUF 4096 //default tcp send ring size (bytes), at most 65535
+#define ESIX_RCVBUF 2048 //default tcp receive ring size (bytes), our window, at most 65535
 
 #define INTERFACE	0 //default interface # until we have a proper intf
 				//management system.
 #define MAX_RETX_TIME 120
+#define ESIX_MSL 30 //tcp maximum segment lifetime (s), TIME_WAIT lasts twice as long
+#define ESIX_MAX_TW 16 //max number of tcp connections kept in TIME_WAIT
+#define ESIX_MAX_SYN 8 //max number of half-open tcp connections (SYN cookies past that)
+#define ESIX_TICK_MS 20 //period at which esix_tick_callback() is called (ms)
+#define ESIX_DELACK_MS 100 //tcp delayed ACK timeout (ms), must be < 500
+#define ESIX_CORK_MS 200 //max time a partial segment stays corked (ms)
+#define ESIX_KEEPIDLE 7200 //default SO_KEEPALIVE idle time before probing (s)
+#define ESIX_KEEPINTVL 75 //default time between unanswered keepalive probes (s)
+#define ESIX_KEEPCNT 9 //default unanswered keepalive probes before giving up
+#define ESIX_BLOCKING 1 //1 : recv(), accept(), send() and connect() wait for something to
+			//happen, through esix_w_sem_wait/signal(). 0 : they never block.
 
 #define DEFAULT_TTL		64 	//default TTL when unspecified by
 						//router advertisements
@@ -47,6 +47,10 @@ void esix_init(u16_t lla[3])
 		asm("nop");
 
 	current_time = 1;	// 0 means "infinite lifetime" in our caches
+
+	//seed the ISN/port/cookie generator
+	esix_random_stir((lla[0] << 16) | lla[1]);
+	esix_random_stir(lla[2]);
 	
 	for(i=0; i<ESIX_MAX_IPADDR; i++)
 		addrs[i] = NULL;
@@ -65,6 +69,15 @@ void esix_init(u16_t lla[3])
 	esix_icmp_send_router_sol(INTERFACE);
 }
 
+/*
+ * esix_sem_count : how many semaphores esix_w_sem_wait/signal() need,
+ * one per socket plus the one poll() waits on.
+ */
+int esix_sem_count(void)
+{
+	return ESIX_MAX_SOCK + 1;
+}
+
 u32_t esix_get_time()
 {
 	return current_time;
@@ -108,7 +108,7 @@ void esix_icmp_send(const struct ip6_addr *_saddr, const struct ip6_addr *daddr,
 	
 	hdr->chksum = esix_ip_upper_checksum(&saddr, daddr, ICMP, hdr, len + sizeof(struct icmp6_hdr));
 	
-	esix_ip_send(&saddr, daddr, hlimit, ICMP, hdr, len + sizeof(struct icmp6_hdr));
+	esix_ip_send(&saddr, daddr, hlimit, 0, ICMP, hdr, len + sizeof(struct icmp6_hdr));
 
 	esix_w_free(hdr);
 	
@@ -276,16 +276,32 @@ void esix_icmp_process_neighbor_adv(struct icmp6_neighbor_adv *nb_adv, int len,
 
 /*
  * Process an ICMPv6 Echo Request and send an echo reply.
+ * The reply is the request with another type, and maybe another source
+ * address if it was sent to a multicast group : its checksum is the
+ * request's one, updated for these two words.
  */
 void esix_icmp_process_echo_req(struct icmp6_echo *echo_req, int len, struct ip6_hdr *ip_hdr)
 {
-	struct icmp6_echo *echo_rep = esix_w_malloc(len);
-	if(echo_rep == NULL)
+	struct icmp6_hdr *req = ((struct icmp6_hdr *) echo_req) - 1;
+	struct icmp6_hdr *rep;
+	struct ip6_addr saddr = ip_hdr->daddr;
+
+	if(esix_intf_check_source_addr(&saddr, &ip_hdr->saddr) < 0)
+		return;
+
+	if((rep = esix_w_malloc(sizeof(struct icmp6_hdr) + len)) == NULL)
 		return;
 	//copying the whole packet and sending it back to its source should do the trick.	
-	esix_memcpy(echo_rep, echo_req, len);
+	esix_memcpy(rep, req, sizeof(struct icmp6_hdr) + len);
+	rep->type = ECHO_RP;
+	rep->code = 0;
+
+	rep->chksum = esix_ip_adjust_checksum(req->chksum, req, rep, 2);
+	rep->chksum = esix_ip_adjust_checksum(rep->chksum, &ip_hdr->daddr, &saddr, 16);
+
+	esix_ip_send(&saddr, &ip_hdr->saddr, 64, 0, ICMP, rep, sizeof(struct icmp6_hdr) + len);
 
-	esix_icmp_send(&ip_hdr->daddr, &ip_hdr->saddr, 64, ECHO_RP, 0, echo_rep, len);
+	esix_w_free(rep);
 }
 
 /*
@@ -631,7 +647,7 @@ void esix_icmp_send_mld(const struct ip6_addr *mcast_addr, int mld_type)
 
         //TODO: implement timers
         struct icmp6_mld1_hdr *hdr;
-        struct ip6_addr *target = (struct ip6_addr*) (hdr+1);
+        struct ip6_addr *target;
 	int i = esix_intf_get_type_address(LINK_LOCAL); 
 
 
@@ -642,6 +658,7 @@ void esix_icmp_send_mld(const struct ip6_addr *mcast_addr, int mld_type)
                 return;
 
         hdr->max_resp_delay = 0;
+        target = (struct ip6_addr*) (hdr+1);
         *target = *mcast_addr;
 
         if(mld_type == MLD_RPT)
@@ -46,6 +46,17 @@
 	 */
 	void esix_ip_process(void *packet, int len);
 
+	/*
+	 * Process a received IPv6 packet, handing its buffer over to esix.
+	 * UDP datagrams are queued right out of it instead of being copied,
+	 * recv_zc() lends them to the application as is.
+	 *
+	 * @param packet is a pointer to the packet, allocated with esix_w_malloc().
+	 * It's freed with esix_w_free() once esix is done with it.
+	 * @param len is the packet size.
+	 */
+	void esix_ip_process_buf(void *packet, int len);
+
 	/*
 	 * ipv6 stack clock signal.
 	 *
@@ -53,6 +64,21 @@
 	 *
 	 */
 	void esix_periodic_callback();
+
+	/*
+	 * ipv6 stack fast clock signal, drives the sub-second timers.
+	 *
+	 * Needs to be called every esix_tick_ms() ms by the user.
+	 *
+	 */
+	void esix_tick_callback();
+
+	/*
+	 * Period at which esix_tick_callback() has to be called.
+	 *
+	 * @return the period in ms (ESIX_TICK_MS).
+	 */
+	u16_t esix_tick_ms(void);
 	
 // The following has to be implemented by the user
 
@@ -85,4 +111,36 @@
 	 * @param len is the len of the IPv6 packet in bytes.
 	 */
 	void esix_w_send_packet(u16_t lla[3], void *packet, int len);
+
+	/*
+	 * Wait for esix_w_sem_signal() to be called for a socket.
+	 *
+	 * Needs to be implemented by the user if ESIX_BLOCKING is set
+	 * (a binary semaphore per socket does it).
+	 *
+	 * @param socket is the socket the calling task waits on, or
+	 * esix_sem_count() - 1 in poll().
+	 * @param timeout is the max time to wait (in ms), 0 for no limit.
+	 * @return 0 if the time is up, 1 otherwise.
+	 */
+	int esix_w_sem_wait(int socket, u32_t timeout);
+
+	/*
+	 * Wake up the task waiting on a socket. If none is, the next
+	 * esix_w_sem_wait() call for that socket has to return right away.
+	 *
+	 * Needs to be implemented by the user if ESIX_BLOCKING is set.
+	 * Called from the task running esix.
+	 *
+	 * @param socket is the socket something happened on.
+	 */
+	void esix_w_sem_signal(int socket);
+
+	/*
+	 * Number of semaphores esix_w_sem_wait/signal() have to handle : they
+	 * get socket numbers from 0 to esix_sem_count() - 1.
+	 *
+	 * @return ESIX_MAX_SOCK + 1.
+	 */
+	int esix_sem_count(void);
 #endif
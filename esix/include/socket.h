@@ -34,8 +34,44 @@
 #define SOCK_STREAM 0x06
 #define SOCK_DGRAM 0x11
 
-#define MSG_PEEK 1
+#define MSG_PEEK 1 //read without taking it out of the socket
 #define MSG_DONTWAIT 2
+#define MSG_TRUNC 4 //UDP : return the real datagram length, TCP : discard instead of copying
+#define MSG_WAITALL 8 //TCP : wait for len bytes, not just some
+
+//poll() events
+#define POLLIN 0x001 //there's something to read (or a connection to accept)
+#define POLLOUT 0x004 //there's room to send
+#define POLLERR 0x008 //the socket went away (reset, aborted or closed)
+#define POLLHUP 0x010 //same
+#define POLLNVAL 0x020 //not a socket
+#define POLLET 0x4000 //esix specific : edge-triggered, report events once
+
+//setsockopt levels
+#define SOL_SOCKET 1
+#define IPPROTO_TCP 6
+#define IPPROTO_IPV6 41
+
+//SOL_SOCKET options
+#define SO_REUSEADDR 2 //UDP : several sockets setting it can bind the same port
+#define SO_SNDBUF 7 //TCP : send ring size (bytes), UDP : max datagram size
+#define SO_RCVBUF 8 //TCP : receive ring size (bytes, the window), UDP : datagram queue size (bytes)
+#define SO_KEEPALIVE 9 //probe the peer of an idle TCP connection, abort if it's gone
+#define SO_RCVTIMEO 20 //max time (ms) recv() and accept() block, 0 : no limit
+#define SO_SNDTIMEO 21 //max time (ms) send() and connect() block, 0 : no limit
+#define SO_RCVDROPS 128 //esix specific, getsockopt() only : UDP datagrams dropped for lack of room
+
+//IPPROTO_TCP options
+#define TCP_NODELAY 1 //send small segments right away (disable Nagle)
+#define TCP_CORK 3 //only send full-sized segments (for up to 200ms)
+#define TCP_KEEPIDLE 4 //idle time (s) before the first keepalive probe
+#define TCP_KEEPINTVL 5 //time (s) between keepalive probes
+#define TCP_KEEPCNT 6 //unanswered keepalive probes before aborting
+#define TCP_IDLE_TIMEOUT 128 //esix specific : abort after that many seconds without hearing from the peer, 0 : never
+
+//IPPROTO_IPV6 options (UDP)
+#define IPV6_JOIN_GROUP 20 //receive a multicast group's datagrams (struct ipv6_mreq)
+#define IPV6_LEAVE_GROUP 21 //stop receiving them (struct ipv6_mreq)
 
 /*
  * IPv6 address.
@@ -50,9 +86,28 @@ struct in6_addr
 	};
 };
 
+/*
+ * Socket to poll().
+ */
+struct pollfd
+{
+	int fd; // Socket identifier, ignored if negative
+	short events; // POLLIN, POLLOUT, POLLET
+	short revents; // Events it's ready for, set by poll()
+};
+
 extern const struct in6_addr in6addr_any;
 extern const struct in6_addr in6addr_loopback;
 
+/*
+ * Multicast group membership, for IPV6_JOIN_GROUP and IPV6_LEAVE_GROUP.
+ */
+struct ipv6_mreq
+{
+	struct in6_addr ipv6mr_multiaddr; // IPv6 multicast address of the group
+	unsigned int ipv6mr_interface; // interface index, not used
+};
+
 /*
  * IPv6 sockaddr.
  */
@@ -65,6 +120,17 @@ struct sockaddr_in6
 	u32_t sin6_scope_id; // Scope ID, not used
 };
 
+/*
+ * One datagram for recvmmsg() and sendmmsg().
+ */
+struct mmsghdr
+{
+	struct sockaddr_in6 msg_name; // where it came from / goes to
+	void *msg_buf; // datagram payload
+	int msg_size; // room in msg_buf, for recvmmsg()
+	int msg_len; // bytes in msg_buf : received, or to be sent
+};
+
 /*
  * Create a socket.
  *
@@ -77,6 +143,7 @@ int socket(const int family, const u8_t type, const u8_t proto);
 
 /*
  * Change properties of a socket.
+ * Must be called before listen() or connect().
  *
  * @param socket is the socket idenfier.
  * @param address is a pointer to the IPv6 sockaddr stuct to be used.
@@ -91,7 +158,9 @@ int bind(const int socket, const struct sockaddr_in6 *address, const int addrlen
  * @param socket is the socket idenfier.
  * @param to is a pointer to the IPv6 sockaddr stuct to be used.
  * @param addrlen is the size of to.
- * @return 0 in success.
+ * @return 0 in success. With ESIX_BLOCKING, a TCP connect() waits for the
+ * connection to be established, at most SO_SNDTIMEO ms : it returns -1 once
+ * that's over, but the connection attempt goes on.
  */
 int connect(const int socket, const struct sockaddr_in6 *to, const int addrlen);
 
@@ -99,7 +168,8 @@ int connect(const int socket, const struct sockaddr_in6 *to, const int addrlen);
  * Listen for connections.
  *
  * @param socket is the socket idenfier.
- * @param num is the number of connections allowed on the socket.
+ * @param num is the number of connections allowed to wait for accept() (and
+ * to be half-open) on the socket. Past that, SYN cookies are used.
  * @return 0 in success.
  */
 int listen(int socket, int num);
@@ -110,7 +180,8 @@ int listen(int socket, int num);
  * @param socket is the socket idenfier.
  * @param address is a pointer to the IPv6 sockaddr stuct to be used.
  * @param addrlen is the size of address.
- * @return a socket identifier for the connection.
+ * @return a socket identifier for the connection. With ESIX_BLOCKING, waits
+ * for one at most SO_RCVTIMEO ms.
  */
 int accept(int socket, struct sockaddr_in6 *address, int *addrlen);
 
@@ -128,8 +199,13 @@ int close(int socket);
  * @param socket is the socket idenfier.
  * @param buff is a pointer to a buffer where the received data can be copied.
  * @param len is the length (in bytes) os the buffer.
- * @param flags could contain the following flags: MSG_PEEK, MSG_DONTWAIT.
- * @return the number of bytes read.
+ * @param flags could contain the following flags: MSG_PEEK, MSG_DONTWAIT,
+ * MSG_TRUNC, MSG_WAITALL.
+ * @return the number of bytes read. For TCP, up to len bytes of the stream
+ * are read, whatever the segments they arrived in. With ESIX_BLOCKING and
+ * without MSG_DONTWAIT, waits for data at most SO_RCVTIMEO ms ; with
+ * MSG_WAITALL, until len bytes came in or the peer closed. For UDP, what
+ * doesn't fit in buff is lost, and MSG_TRUNC returns the full datagram length.
  */
 int recv(int socket, void *buff, int len, u8_t flags);
 
@@ -139,23 +215,43 @@ int recv(int socket, void *buff, int len, u8_t flags);
  * @param socket is the socket idenfier.
  * @param buff is a pointer to a buffer containing the data to be sent.
  * @param len is the number of bytes to send.
- * @param flags is not used (for now).
+ * @param flags could contain MSG_DONTWAIT.
  * @param from is a pointer to an IPv6 sockaddr struct (containing destination details).
  * @param fromaddrlen is a pointer to the size of from.
- * @return the number of bytes sent.
+ * @return the number of bytes sent. For TCP, this can be less than len when
+ * the send ring fills up : the remaining bytes have to be sent again. With
+ * ESIX_BLOCKING and without MSG_DONTWAIT, waits for room in the ring
+ * instead, at most SO_SNDTIMEO ms.
  */
 int send(int socket, const void *buff, int len, u8_t flags);
 
+/*
+ * Send data through a TCP socket without copying it to the send ring.
+ * The buffer is only referenced : segments and retransmissions are built
+ * out of it, so it must not change nor go away until done is called.
+ *
+ * @param socket is the socket idenfier.
+ * @param buff is a pointer to the data to be sent.
+ * @param len is the number of bytes to send.
+ * @param done is called (from the stack) with arg once buff isn't needed
+ * anymore : status is 0 when all of it was acknowledged, -1 when the
+ * connection went away first. Can be NULL.
+ * @param arg is passed to done as is.
+ * @return len, or -1 if the data couldn't be queued.
+ */
+int send_ref(int socket, const void *buff, int len,
+	void (*done)(int socket, void *arg, int status), void *arg);
+
 /*
  * Receive data from the socket.
  * 
  * @param socket is the socket idenfier.
  * @param buff is a pointer to a buffer where the received data can be copied.
  * @param len is the length (in bytes) os the buffer.
- * @param flags could contain the following flags: MSG_PEEK, MSG_DONTWAIT.
+ * @param flags could contain the same flags as recv().
  * @param from is a pointer to an IPv6 sockaddr struct (where sender details will be copied).
  * @param fromaddrlen is a pointer to the size of from.
- * @return the number of bytes read.
+ * @return the number of bytes read. Waits for data like recv().
  */
 int recvfrom(int, void *, int, int, struct sockaddr_in6*, int *);
 
@@ -173,4 +269,131 @@ int recvfrom(int, void *, int, int, struct sockaddr_in6*, int *);
 
 int sendto(int socket, const void *buff, int len, u8_t flags, const struct sockaddr_in6 *to, int toaddrlen);
 
+/*
+ * Receive several datagrams at once (UDP only).
+ *
+ * @param socket is the socket idenfier.
+ * @param msgs is an array of vlen datagrams, msg_buf and msg_size set.
+ * msg_name and msg_len are filled in for each one received.
+ * @param vlen is the number of elements in msgs.
+ * @param flags could contain MSG_DONTWAIT, MSG_TRUNC.
+ * @return the number of datagrams received. Only waits for the first one,
+ * like recv().
+ */
+int recvmmsg(int socket, struct mmsghdr *msgs, int vlen, u8_t flags);
+
+/*
+ * Receive a datagram without copying it (UDP only) : the buffer it came
+ * in is lent to the application, which gives it back with release().
+ * Datagrams handed to esix through esix_ip_process_buf() were never
+ * copied at all. A multicast datagram is shared by all the sockets it
+ * went to : it must not be written to.
+ *
+ * @param socket is the socket idenfier.
+ * @param data is where the pointer to the payload is stored, NULL if
+ * there was no datagram.
+ * @param from is a pointer to an IPv6 sockaddr struct (where sender details
+ * will be copied), can be NULL.
+ * @param flags could contain MSG_DONTWAIT.
+ * @return the payload length. Waits for a datagram like recv().
+ */
+int recv_zc(int socket, void **data, struct sockaddr_in6 *from, u8_t flags);
+
+/*
+ * Give back a datagram buffer lent by recv_zc().
+ *
+ * @param data is the payload pointer recv_zc() returned, can be NULL.
+ */
+void release(void *data);
+
+/*
+ * Send several datagrams at once (UDP only).
+ * Consecutive datagrams to the same address share the source address,
+ * route and neighbor lookup.
+ *
+ * @param socket is the socket idenfier.
+ * @param msgs is an array of vlen datagrams, msg_buf and msg_len set.
+ * msg_name is their destination, unless the socket is connected.
+ * @param vlen is the number of elements in msgs.
+ * @param flags is not used (for now).
+ * @return the number of datagrams sent, -1 if none could go.
+ */
+int sendmmsg(int socket, const struct mmsghdr *msgs, int vlen, u8_t flags);
+
+/*
+ * Wait for sockets to be ready.
+ * Readiness is kept up to date by the stack as things happen, so polling
+ * many sockets is cheap. By default (level-triggered), a socket is reported
+ * for as long as it's ready. With POLLET in events, each time something
+ * new comes up it is only reported once.
+ * With ESIX_BLOCKING, one task at a time can wait in poll().
+ *
+ * @param fds is the array of sockets to poll.
+ * @param nfds is the number of elements in fds.
+ * @param timeout is the max time to wait (in ms), -1 for no limit, 0 to
+ * return right away.
+ * @return the number of sockets with events in revents, 0 if the time is up.
+ */
+int poll(struct pollfd *fds, int nfds, int timeout);
+
+/*
+ * Raw API : callbacks the stack calls right from its receive path as
+ * things happen on a socket, instead of going through recv() and accept().
+ * They run in the task driving esix, can call send() (with MSG_DONTWAIT)
+ * and close() and should return quickly.
+ */
+struct sock_callbacks
+{
+	// Data arrived. It's only loaned for the call. from is NULL for TCP,
+	// data is NULL and len 0 once the peer closed the connection.
+	void (*on_recv)(int socket, const void *data, int len, const struct sockaddr_in6 *from, void *arg);
+	// The peer acknowledged len more bytes.
+	void (*on_sent)(int socket, int len, void *arg);
+	// A connection was established on a listening socket : conn is its
+	// identifier, it gets the callbacks of the listener.
+	void (*on_accept)(int socket, int conn, void *arg);
+	// The connection was refused, reset or timed out. The socket is gone.
+	void (*on_error)(int socket, void *arg);
+};
+
+/*
+ * Register raw API callbacks on a socket.
+ * Any of them can be NULL : the regular calls are used for that event then.
+ *
+ * @param socket is the socket idenfier.
+ * @param cb is a pointer to the callbacks, which must stay around.
+ * NULL unregisters them.
+ * @param arg is passed to the callbacks as is.
+ * @return 0 in success.
+ */
+int set_callbacks(int socket, const struct sock_callbacks *cb, void *arg);
+
+/*
+ * Set a socket option.
+ *
+ * @param socket is the socket idenfier.
+ * @param level is the level the option belongs to (SOL_SOCKET, IPPROTO_TCP,
+ * IPPROTO_IPV6).
+ * @param option is the option name.
+ * @param value is a pointer to the option value : an int, or a struct
+ * ipv6_mreq for IPV6_JOIN_GROUP and IPV6_LEAVE_GROUP.
+ * @param len is the size of value.
+ * @return 0 in success. The TCP ring sizes (SO_SNDBUF, SO_RCVBUF) can't
+ * change once the connection started : accepted connections get the
+ * listener's.
+ */
+int setsockopt(int socket, int level, int option, const void *value, int len);
+
+/*
+ * Get a socket option.
+ *
+ * @param socket is the socket idenfier.
+ * @param level is the level the option belongs to (SOL_SOCKET, IPPROTO_TCP).
+ * @param option is the option name.
+ * @param value is a pointer to where the option value will be copied.
+ * @param len is a pointer to the size of value, updated with the actual size.
+ * @return 0 in success.
+ */
+int getsockopt(int socket, int level, int option, void *value, int *len);
+
 #endif
@@ -140,6 +140,16 @@ void esix_intf_add_default_routes(u8_t intf_index, int intf_mtu)
 	esix_intf_add_route_row(mcast_rt);
 }
 
+/*
+ * To be called whenever addresses, routes or neighbors change :
+ * what was worked out of them (packet templates) is checked again.
+ */
+void esix_intf_changed()
+{
+	if(++esix_intf_gen == 0)
+		esix_intf_gen = 1;
+}
+
 int esix_intf_add_neighbor_row(struct esix_neighbor_table_row *row)
 {
 	int i=0;
@@ -150,6 +160,7 @@ int esix_intf_add_neighbor_row(struct esix_neighbor_table_row *row)
 		if(neighbors[i] == NULL)
 		{
 			neighbors[i] = row;
+			esix_intf_changed();
 			return 1;
 		}
 		i++;
@@ -170,6 +181,7 @@ int esix_intf_add_neighbor(const struct ip6_addr *addr, esix_ll_addr lla, u32_t
 		neighbors[i]->expiration_date	= expiration_date;
 		for(j = 0; j < 3; j++)
 			neighbors[i]->lla[j] = lla[j];
+		esix_intf_changed();
 		return 1;
 	}
 
@@ -214,6 +226,7 @@ int esix_intf_add_address_row(struct esix_ipaddr_table_row *row)
 		if(addrs[i] == NULL)
 		{
 			addrs[i] = row;
+			esix_intf_changed();
 			return 1;
 		}
 		i++;
@@ -247,6 +260,7 @@ int esix_intf_add_route_row(struct esix_route_table_row *row)
 	//sorry dude, table was full.
 	if(j < 0)
 		return 0;
+	esix_intf_changed();
 
 /*
 	//sort the table to ease the routing process
@@ -329,6 +343,7 @@ int esix_intf_remove_neighbor(const struct ip6_addr *addr, u8_t interface)
 		row = neighbors[i];
 		neighbors[i] = NULL; 
 		esix_w_free(row);
+		esix_intf_changed();
 		return 1;
 	}
 
@@ -537,13 +552,15 @@ int esix_intf_remove_address(const struct ip6_addr *addr, enum type type, u8_t m
 	i = esix_intf_get_address_index(addr, type, masklen);
 	if(i >= 0)
 	{
+		row = addrs[i];
+
               //send a MLD done report if this is a mcast address
                 if(type == MULTICAST)
                         esix_icmp_send_mld(&row->addr, MLD_DNE);
 
-		row = addrs[i];
 		addrs[i] = NULL; 
 		esix_w_free(row);
+		esix_intf_changed();
 	//	uart_printf("esix_intf_remove_address: removed %x %x %x %x\n",
           //      	addr->addr1, addr->addr2,  addr->addr3,  addr->addr4);
 
@@ -628,6 +645,7 @@ int esix_intf_remove_route(struct ip6_addr *daddr, struct ip6_addr *mask, struct
 		rt	= routes[i];
 		routes[i] = NULL;
 		esix_w_free(rt);
+		esix_intf_changed();
 		return 1;
 	}
 	return -1;
@@ -97,6 +97,11 @@ struct esix_route_table_row *routes[ESIX_MAX_RT];
 //table of the neighbors
 struct esix_neighbor_table_row *neighbors[ESIX_MAX_NB];
 
+//changes along with any of the tables above, never 0
+u32_t esix_intf_gen;
+
+void esix_intf_changed(void);
+
 
 void esix_intf_init_interface(esix_ll_addr, u8_t);
 void esix_intf_add_default_neighbors(esix_ll_addr);
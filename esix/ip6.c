@@ -102,28 +102,56 @@ void esix_ip_process(void *packet, int len)
 	}
 }
 
+void esix_ip_process_buf(void *packet, int len)
+{
+	esix_ip_rx_buf = packet;
+	esix_ip_process(packet, len);
+
+	//nobody kept it
+	if(esix_ip_rx_buf != NULL)
+		esix_w_free(packet);
+	esix_ip_rx_buf = NULL;
+}
+
 /*
- * Compute upper-level checksum
+ * Sum of the IPv6 pseudo-header fields that don't change along a flow :
+ * addresses and upper protocol. Left unfolded.
  */
-u16_t esix_ip_upper_checksum(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t proto, const void *payload, u16_t len)
+u32_t esix_ip_pseudo_sum(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t proto)
 {
 	u32_t sum = 0;
 	u16_t const *data;
-	
-	// IPv6 pseudo-header sum : saddr, daddr, type and payload lenght
+
 	for(data = (u16_t *) saddr; data < (u16_t *) (saddr+1); data++)
 		sum += *data;
 	for(data = (u16_t *) daddr; data < (u16_t *) (daddr+1); data++)
 		sum += *data;
-	sum += hton16(len);
 	sum += hton16(proto);
 
-	// payload sum
+	return sum;
+}
+
+/*
+ * Adds len bytes to an unfolded one's complement sum. Sums of pieces starting
+ * at even offsets can be added up in any order.
+ */
+u32_t esix_ip_sum(u32_t sum, const void *payload, u16_t len)
+{
+	u16_t const *data;
+
 	for(data = payload; len > 1; len -= 2)
 		sum += *data++;
 	if(len)
 		sum += *((u8_t *) data);
 
+	return sum;
+}
+
+/*
+ * Folds a sum down to the 16 bits checksum field.
+ */
+u16_t esix_ip_fold_checksum(u32_t sum)
+{
 	while(sum >> 16)
 		sum = (sum & 0xffff) + (sum >> 16);
 	
@@ -131,29 +159,46 @@ u16_t esix_ip_upper_checksum(const struct ip6_addr *saddr, const struct ip6_addr
 }
 
 /*
- * Send an IPv6 packet.
- * Note that we're not freeing the buffer carrying the payload here, it's up to the upper layer to decide
- * when to do it. Non-retransmitting procotols like UDP or ICMP will typically do it ASAP, but TCP might
- * want to keep it while waiting for an ACK. 
+ * Completes a pseudo-header sum with the payload length and the payload.
  */
-void esix_ip_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t hlimit, const u8_t type, const void *data, const u16_t len)
+u16_t esix_ip_finish_checksum(u32_t sum, const void *payload, u16_t len)
+{
+	return esix_ip_fold_checksum(esix_ip_sum(sum + hton16(len), payload, len));
+}
+
+/*
+ * Updates a checksum after len bytes (an even count, at an even offset) of
+ * what it covers changed from old to new, without summing the rest again
+ * (RFC 1624 : HC' = ~(~HC + ~m + m')).
+ */
+u16_t esix_ip_adjust_checksum(u16_t chksum, const void *old, const void *new, u16_t len)
+{
+	u32_t sum = (u16_t) ~chksum;
+	const u16_t *o = old;
+	const u16_t *n = new;
+
+	for(; len > 1; len -= 2)
+		sum += (u16_t) ~*o++ + *n++;
+
+	return esix_ip_fold_checksum(sum);
+}
+
+/*
+ * Compute upper-level checksum
+ */
+u16_t esix_ip_upper_checksum(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t proto, const void *payload, u16_t len)
+{
+	return esix_ip_finish_checksum(esix_ip_pseudo_sum(saddr, daddr, proto), payload, len);
+}
+
+/*
+ * Finds the link-layer address of the next hop towards daddr.
+ * Returns -1 if there's no route or if the neighbor isn't known yet,
+ * in which case it gets solicited.
+ */
+int esix_ip_next_hop(const struct ip6_addr *daddr, esix_ll_addr lla)
 {
-	struct ip6_hdr *hdr;
 	int i, route_index, dest_onlink;
-	esix_ll_addr lla;
-	
-	hdr = esix_w_malloc(sizeof(struct ip6_hdr) + len);
-	//hmmm... I smell gas...
-	if(hdr == NULL)
-		return;
-	
-	hdr->ver_tc_flowlabel = hton32(6 << 28);
-	hdr->payload_len = hton16(len);
-	hdr->next_header = type;
-	hdr->hlimit = hlimit;
-	hdr->saddr = *saddr;
-	hdr->daddr = *daddr;
-	esix_memcpy(hdr + 1, data, len);
 
 	route_index = -1;
 	//routing
@@ -181,8 +226,7 @@ void esix_ip_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, co
 	if(route_index < 0)
 	{
 		uart_printf("esix_ip_send : no route.\n");
-		esix_w_free(hdr);
-		return;
+		return -1;
 	}
 	// try to find our next hop lla
 	if(routes[route_index]->next_hop.addr1 == 0 && routes[route_index]->next_hop.addr2 == 0 &&
@@ -198,9 +242,7 @@ void esix_ip_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, co
 			lla[0]	=	0x3333;
 			lla[1]	=	(u16_t) daddr->addr4;
 			lla[2]	= 	(u16_t) (daddr->addr4 >> 16);
-
-			esix_w_send_packet(lla, hdr, len + sizeof(struct ip6_hdr));
-			return;
+			return 0;
 		}
 		else
 			//it must be unicast, use the neighbor table.
@@ -219,14 +261,15 @@ void esix_ip_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, co
 		if(neighbors[i]->flags.status == ND_REACHABLE ||
 			neighbors[i]->flags.status == ND_STALE)
 		{
-			//packet leaves here.
-			esix_w_send_packet(neighbors[i]->lla, hdr, len + sizeof(struct ip6_hdr));
+			lla[0]	= neighbors[i]->lla[0];
+			lla[1]	= neighbors[i]->lla[1];
+			lla[2]	= neighbors[i]->lla[2];
+			return 0;
 		}
 		else
 		{
 			uart_printf("esix_ip_send : neighbor unreachable\n");
-			esix_w_free(hdr);
-			return;
+			return -1;
 		}
 	}
 	else
@@ -240,7 +283,92 @@ void esix_ip_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, co
 			else
 				esix_icmp_send_neighbor_sol(&addrs[i]->addr, &routes[route_index]->next_hop);
 		}
+		return -1;
+	}
+}
+
+/*
+ * Send an IPv6 packet.
+ * Note that we're not freeing the buffer carrying the payload here, it's up to the upper layer to decide
+ * when to do it. Non-retransmitting procotols like UDP or ICMP will typically do it ASAP, but TCP might
+ * want to keep it while waiting for an ACK. 
+ */
+void esix_ip_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t hlimit, const u8_t tc, const u8_t type, const void *data, const u16_t len)
+{
+	struct ip6_hdr *hdr;
+	esix_ll_addr lla;
+	
+	hdr = esix_w_malloc(sizeof(struct ip6_hdr) + len);
+	//hmmm... I smell gas...
+	if(hdr == NULL)
+		return;
+	
+	hdr->ver_tc_flowlabel = hton32((6 << 28) | (tc << 20));
+	hdr->payload_len = hton16(len);
+	hdr->next_header = type;
+	hdr->hlimit = hlimit;
+	hdr->saddr = *saddr;
+	hdr->daddr = *daddr;
+	esix_memcpy(hdr + 1, data, len);
+
+	//packet leaves here.
+	if(esix_ip_next_hop(daddr, lla) < 0)
+	{
 		esix_w_free(hdr);
+		return;
 	}
-	return;
+	esix_w_send_packet(lla, hdr, len + sizeof(struct ip6_hdr));
+}
+
+/*
+ * Sets up the template of the packets a connected socket sends. The next hop
+ * is only resolved when the first packet goes.
+ */
+void esix_ip_tmpl_init(struct esix_ip_tmpl *t, const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t hlimit, const u8_t type)
+{
+	t->gen			= 0;
+	t->hdr.ver_tc_flowlabel	= hton32(6 << 28);
+	t->hdr.payload_len	= 0;
+	t->hdr.next_header	= type;
+	t->hdr.hlimit		= hlimit;
+	t->hdr.saddr		= *saddr;
+	t->hdr.daddr		= *daddr;
+	t->sum			= esix_ip_pseudo_sum(saddr, daddr, type);
+}
+
+/*
+ * Allocates a packet out of a template, with room for len bytes of payload
+ * right after the IPv6 header. The template's source address and next hop
+ * are checked again only when addresses, routes or neighbors changed since.
+ * Returns NULL if the packet can't go.
+ */
+struct ip6_hdr *esix_ip_tmpl_packet(struct esix_ip_tmpl *t, const u16_t len)
+{
+	struct ip6_hdr *hdr;
+
+	if(t->gen != esix_intf_gen)
+	{
+		if(esix_intf_check_source_addr(&t->hdr.saddr, &t->hdr.daddr) < 0 ||
+			esix_ip_next_hop(&t->hdr.daddr, t->lla) < 0)
+			return NULL;
+		t->gen = esix_intf_gen;
+	}
+
+	if((hdr = esix_w_malloc(sizeof(struct ip6_hdr) + len)) == NULL)
+		return NULL;
+
+	*hdr = t->hdr;
+	hdr->payload_len = hton16(len);
+	return hdr;
+}
+
+/*
+ * Sends a packet allocated by esix_ip_tmpl_packet, once its payload is filled.
+ */
+void esix_ip_tmpl_send(struct esix_ip_tmpl *t, struct ip6_hdr *hdr, const u8_t tc)
+{
+	if(tc != 0)
+		hdr->ver_tc_flowlabel = hton32((6 << 28) | (tc << 20));
+
+	esix_w_send_packet(t->lla, hdr, ntoh16(hdr->payload_len) + sizeof(struct ip6_hdr));
 }
@@ -61,6 +61,13 @@
 		u32_t	addr4;
 	} __attribute__((__packed__));
 	
+	//ECN codepoints, the low 2 bits of the traffic class (RFC 3168)
+	#define ECN_NOT_ECT	0
+	#define ECN_ECT1	1
+	#define ECN_ECT0	2
+	#define ECN_CE		3
+	#define IP6_ECN(hdr)	((ntoh32((hdr)->ver_tc_flowlabel) >> 20) & 3)
+
 	/**
 	 * IPv6 header 
 	 */
@@ -75,7 +82,31 @@
 	} __attribute__((__packed__));
 	
 	void esix_ip_process_packet(void *, int);
-	void esix_ip_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t hlimit, const u8_t type, const void *data, const u16_t len);
+
+	//buffer of the packet esix_ip_process_buf() is going through,
+	//NULL once something took it over
+	void *esix_ip_rx_buf;
+	/**
+	 * What the packets of a connected socket start with, worked out once :
+	 * IPv6 header, next hop and pseudo-header sum.
+	 */
+	struct esix_ip_tmpl {
+		u32_t gen; //esix_intf_gen it was checked at, 0 : never
+		u16_t lla[3]; //next hop link-layer address
+		struct ip6_hdr hdr; //payload length and traffic class are patched
+		u32_t sum; //pseudo-header sum, payload length left out
+	};
+
+	void esix_ip_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t hlimit, const u8_t tc, const u8_t type, const void *data, const u16_t len);
+	int esix_ip_next_hop(const struct ip6_addr *daddr, u16_t lla[3]);
+	void esix_ip_tmpl_init(struct esix_ip_tmpl *t, const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t hlimit, const u8_t type);
+	struct ip6_hdr *esix_ip_tmpl_packet(struct esix_ip_tmpl *t, const u16_t len);
+	void esix_ip_tmpl_send(struct esix_ip_tmpl *t, struct ip6_hdr *hdr, const u8_t tc);
+	u32_t esix_ip_pseudo_sum(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t proto);
+	u16_t esix_ip_finish_checksum(u32_t sum, const void *payload, u16_t len);
+	u32_t esix_ip_sum(u32_t sum, const void *payload, u16_t len);
+	u16_t esix_ip_fold_checksum(u32_t sum);
+	u16_t esix_ip_adjust_checksum(u16_t chksum, const void *old, const void *new, u16_t len);
 	u16_t esix_ip_upper_checksum(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u8_t proto, const void *data, u16_t len);
 	
 #endif
@@ -9,90 +9,245 @@
 const struct in6_addr in6addr_any = {{{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}}};
 const struct in6_addr in6addr_loopback = {{{0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0}}};
 
+//keeps peers from guessing which sockets share a bucket
+static u32_t esix_socket_hash_seed;
+
+//tasks blocked in poll()
+static int esix_pollers;
+
 void esix_socket_init()
 {
 	int i=ESIX_MAX_SOCK;
 	while(i-->0)
+	{
 		esix_sockets[i].state = CLOSED;
+		esix_sockets[i].flags = 0;
+	}
+
+	esix_socket_hash_seed = esix_random();
+	i=ESIX_SOCK_HASH;
+	while(i-->0)
+	{
+		esix_conn_hash[i] = -1;
+		esix_listen_hash[i] = -1;
+		esix_port_hash[i] = -1;
+		esix_tw_port_hash[i] = -1;
+	}
+
+	i=ESIX_MAX_TW;
+	while(i-->0)
+		esix_tw_table[i].expiration_date = 0;
+
+	i=ESIX_MAX_MSHIP;
+	while(i-->0)
+		esix_mships[i].sock = -1;
+
+	i=ESIX_MAX_SYN;
+	while(i-->0)
+		esix_syn_table[i].rexmit_date = 0;
 }
 
-int esix_queue_data(int sock, const void *data, int len, struct sockaddr_in6 *sockaddr, enum direction direction)
+//works out the POLL* events a socket is ready for. only looks at
+//counters, never walks a queue.
+static void esix_socket_ready(int s)
 {
-	//sock queue element 
-	struct sock_queue *sqe, *cur_sqe;
-	int i;
-	u8_t *buf;
+	struct esix_sock *sock = &esix_sockets[s];
+	u8_t ready = 0;
 
-	//don't queue up more than ESIX_QUEUE_DEPHT packets
-	cur_sqe = esix_sockets[sock].queue; 
-	for(i=0; cur_sqe != NULL ; i++)
+	if(sock->state == CLOSED)
+		//reset, aborted or closed
+		ready = POLLERR|POLLHUP;
+	else if(sock->proto == SOCK_DGRAM)
 	{
-		if(i >= ESIX_QUEUE_DEPHT)
-			return -1;
-
-		cur_sqe = cur_sqe->next_e;
+		ready = POLLOUT;
+		if(sock->queue != NULL)
+			ready |= POLLIN;
 	}
-
-	switch(esix_sockets[sock].proto)
+	else if(sock->state == LISTEN)
 	{
-		case SOCK_DGRAM:
-			if((buf = esix_w_malloc(len+sizeof(struct sockaddr_in6))) == NULL ) 
-				return -1;
+		if(sock->accept_head >= 0)
+			ready = POLLIN;
+	}
+	else if(sock->state == ESTABLISHED || sock->state == CLOSE_WAIT)
+	{
+		//past the peer's FIN, recv() tells so right away
+		if(sock->rcv_ring.len > 0 || sock->state == CLOSE_WAIT)
+			ready |= POLLIN;
+		if(sock->snd_ring.len < sock->snd_ring.size)
+			ready |= POLLOUT;
+	}
 
-			esix_memcpy(buf, sockaddr, sizeof(struct sockaddr_in6));
-			esix_memcpy(buf+sizeof(struct sockaddr_in6), data, len);
-		break;
-		case SOCK_STREAM:
-			if((buf = esix_w_malloc(len)) == NULL ) 
-				return -1;
+	sock->ready = ready;
+}
 
-			esix_memcpy(buf, data, len);
-		break;
-		default:
-			return -1;
-		break;
-	}
+//something happened on a socket : updates what it's ready for, records it
+//for edge-triggered poll() and wakes up the task blocked on it, if any.
+void esix_socket_wake(int s)
+{
+	esix_socket_ready(s);
+	esix_sockets[s].ready_edge |= esix_sockets[s].ready;
+#if ESIX_BLOCKING
+	esix_w_sem_signal(s);
+	if(esix_pollers > 0)
+		esix_w_sem_signal(ESIX_MAX_SOCK);
+#endif
+}
 
-	if((sqe = esix_w_malloc(sizeof(struct sock_queue))) == NULL) 
-	{
-		esix_w_free(buf);
+//blocks until something happens on a socket, at most timeout ms (0 : no limit)
+//counted from start. returns -1 when the time is up, or right away when
+//esix doesn't block.
+static int esix_socket_wait(int s, u32_t timeout, u32_t start)
+{
+#if ESIX_BLOCKING
+	u32_t spent = esix_get_time_ms() - start;
+
+	if(timeout == 0)
+		return esix_w_sem_wait(s, 0) ? 0 : -1;
+	if(spent >= timeout)
 		return -1;
-	}
+	return esix_w_sem_wait(s, timeout - spent) ? 0 : -1;
+#else
+	return -1;
+#endif
+}
 
-	sqe->data 	= buf;
-	sqe->data_len 	= len;
-	sqe->next_e	= NULL;
+//appends an element at the end of a socket queue
+static void esix_socket_append_e(int s, struct sock_queue *sqe)
+{
+	struct sock_queue *cur_sqe;
 
-	if(direction == IN) 
-		sqe->qe_type 	= RECV_PKT;
+	sqe->next_e = NULL;
+	if(esix_sockets[s].queue == NULL)
+		esix_sockets[s].queue = sqe;
 	else
 	{
-		sqe->qe_type	= SENT_PKT;
-		sqe->seqn 	= esix_sockets[sock].seqn;
-		sqe->t_sent 	= esix_get_time();
+		cur_sqe = esix_sockets[s].queue;
+		while(cur_sqe->next_e != NULL)
+			cur_sqe = cur_sqe->next_e;
+		cur_sqe->next_e	= sqe;
 	}
+}
 
-	//there's no element in the list.
-	if(esix_sockets[sock].queue == NULL)
-		esix_sockets[sock].queue = sqe;
+//returns a non-zero value if a socket has no room left for a len bytes
+//datagram. an empty queue takes one whatever its size.
+static int esix_socket_queue_full(int s, int len)
+{
+	return esix_sockets[s].queue != NULL &&
+		esix_sockets[s].rcv_queued + len > esix_sockets[s].rcv_size;
+}
+
+//sets up a received udp datagram to be queued, with no reference yet
+static struct esix_dgram *esix_socket_dgram(const void *data, int len, const struct sockaddr_in6 *sockaddr)
+{
+	struct esix_dgram *d;
+
+	//the packet was handed over by esix_ip_process_buf() : keep it,
+	//the sender goes over the headers in front of the payload
+	if(esix_ip_rx_buf != NULL &&
+		(const u8_t *) data - (u8_t *) esix_ip_rx_buf >= sizeof(struct esix_dgram))
+	{
+		d = (struct esix_dgram *) data - 1;
+		d->buf = esix_ip_rx_buf;
+		esix_ip_rx_buf = NULL;
+	}
 	else
 	{
-		//find the end of the list
-		cur_sqe = esix_sockets[sock].queue;
-		while(cur_sqe->next_e != NULL)
-			cur_sqe = cur_sqe->next_e;
+		if((d = esix_w_malloc(sizeof(struct esix_dgram) + len)) == NULL)
+			return NULL;
+		d->buf = d;
+		esix_memcpy(d + 1, data, len);
+	}
+	esix_memcpy(&d->from, sockaddr, sizeof(struct sockaddr_in6));
+	d->refs = 0;
 
-		cur_sqe->next_e	= sqe;
+	return d;
+}
+
+//drops a reference to a datagram, frees it with the last one
+static void esix_socket_dgram_put(struct esix_dgram *d)
+{
+	if(--d->refs == 0)
+		esix_w_free(d->buf);
+}
+
+//queues a datagram on a udp socket. *d is set up with the first
+//socket that takes it, the following ones share it.
+static int esix_socket_deliver(int sock, struct esix_dgram **d, const void *data, int len, struct sockaddr_in6 *sockaddr)
+{
+	//sock queue element 
+	struct sock_queue *sqe;
+
+	//don't queue up more than SO_RCVBUF bytes
+	if(esix_socket_queue_full(sock, len))
+	{
+		esix_sockets[sock].rcv_drops++;
+		return -1;
 	}
 
+	if((*d == NULL && (*d = esix_socket_dgram(data, len, sockaddr)) == NULL) ||
+		(sqe = esix_w_malloc(sizeof(struct sock_queue))) == NULL)
+		return -1;
+
+	(*d)->refs++;
+	sqe->qe_type 	= RECV_PKT;
+	sqe->data 	= *d;
+	sqe->data_len 	= len;
+	esix_socket_append_e(sock, sqe);
+	esix_sockets[sock].rcv_queued += len;
+	esix_socket_wake(sock);
+
+	return len;
+}
+
+//queues a received udp datagram along with its sender
+int esix_queue_data(int sock, const void *data, int len, struct sockaddr_in6 *sockaddr)
+{
+	struct esix_dgram *d = NULL;
+
+	if(esix_sockets[sock].proto != SOCK_DGRAM)
+		return -1;
+
+	len = esix_socket_deliver(sock, &d, data, len, sockaddr);
+
+	//it couldn't be queued after all
+	if(d != NULL && d->refs == 0)
+		esix_w_free(d->buf);
 	return len;
 }
 
+static void esix_socket_clear_rings(int s)
+{
+	esix_sockets[s].snd_ring.buf = NULL;
+	esix_sockets[s].snd_ring.size = esix_sockets[s].snd_ring.head = esix_sockets[s].snd_ring.len = 0;
+	esix_sockets[s].rcv_ring.buf = NULL;
+	esix_sockets[s].rcv_ring.size = esix_sockets[s].rcv_ring.head = esix_sockets[s].rcv_ring.len = 0;
+}
+
+//allocates the rings of a tcp connection
+static int esix_socket_alloc_rings(int s)
+{
+	struct esix_sock *sock = &esix_sockets[s];
+
+	if((sock->snd_ring.buf = esix_w_malloc(sock->snd_size)) == NULL)
+		return -1;
+
+	if((sock->rcv_ring.buf = esix_w_malloc(sock->rcv_size)) == NULL)
+	{
+		esix_w_free(sock->snd_ring.buf);
+		sock->snd_ring.buf = NULL;
+		return -1;
+	}
+
+	sock->snd_ring.size = sock->snd_size;
+	sock->rcv_ring.size = sock->rcv_size;
+	return 0;
+}
+
 int sendto(int sock, const void *buf, int len, u8_t flags, const struct sockaddr_in6 *to, int to_len)
 {
 	int i;
 	//only to be used with UDP
-	if(esix_sockets[sock].proto != SOCK_DGRAM)
+	if(esix_sockets[sock].proto != SOCK_DGRAM || len > esix_sockets[sock].snd_size)
 		return -1;
 
 	// check the source address
@@ -112,28 +267,96 @@ int sendto(int sock, const void *buf, int len, u8_t flags, const struct sockaddr
 	return 0;
 }
 
+int sendmmsg(int sock, const struct mmsghdr *msgs, int vlen, u8_t flags)
+{
+	int i, j;
+	struct esix_ip_tmpl tmpl, *t = &tmpl;
+	const struct sockaddr_in6 *to;
+
+	//only to be used with UDP
+	if(esix_sockets[sock].proto != SOCK_DGRAM)
+		return -1;
+
+	//a connected socket has its own template
+	if(esix_sockets[sock].state == ESTABLISHED)
+		t = &esix_sockets[sock].tmpl;
+
+	for(i = 0; i < vlen; i++)
+	{
+		to = &msgs[i].msg_name;
+
+		//the source address, route and neighbor are only looked up
+		//again when the destination changes
+		if(t == &tmpl && (i == 0 || esix_memcmp(&to->sin6_addr,
+			&msgs[i-1].msg_name.sin6_addr, 16) != 0))
+		{
+			if((j = esix_intf_pick_source_address((struct ip6_addr*) &to->sin6_addr)) < 0)
+				break;
+
+			esix_ip_tmpl_init(&tmpl,
+				esix_memcmp(&esix_sockets[sock].laddr, &in6addr_any, 16) == 0 ?
+				&addrs[j]->addr : &esix_sockets[sock].laddr,
+				(struct ip6_addr*) &to->sin6_addr, DEFAULT_TTL, UDP);
+		}
+
+		if(msgs[i].msg_len > esix_sockets[sock].snd_size ||
+			esix_udp_send_tmpl(t, esix_sockets[sock].lport,
+			t == &tmpl ? to->sin6_port : esix_sockets[sock].rport,
+			msgs[i].msg_buf, msgs[i].msg_len) < 0)
+			break;
+	}
+
+	//nothing could go
+	if(i == 0 && vlen > 0)
+		return -1;
+	return i;
+}
+
 int connect(int sock, const struct sockaddr_in6 *daddr, int len)
 {
 	int i;
+#if ESIX_BLOCKING
+	u32_t start;
+#endif
 	if(esix_sockets[sock].proto == SOCK_STREAM)
 	{
 		if(esix_sockets[sock].state != RESERVED && 
 			esix_sockets[sock].state != CLOSED)
 			return -1;
 
-		if((i=esix_intf_pick_source_address((struct ip6_addr*) daddr)) < 0)
+		if((i=esix_intf_pick_source_address((struct ip6_addr*) &daddr->sin6_addr)) < 0 ||
+			esix_socket_alloc_rings(sock) < 0)
 			return -1;
 
 		//connect() launches the tcp establishment procedure
+		if(esix_memcmp(&esix_sockets[sock].laddr, &in6addr_any, 16) == 0)
+			esix_memcpy(&esix_sockets[sock].laddr, &addrs[i]->addr, 16);
 		esix_sockets[sock].ackn = 0;
 		esix_sockets[sock].rport = daddr->sin6_port;
 		esix_memcpy(&esix_sockets[sock].raddr, &daddr->sin6_addr, 16);
+		esix_ip_tmpl_init(&esix_sockets[sock].tmpl, &esix_sockets[sock].laddr,
+			&esix_sockets[sock].raddr, DEFAULT_TTL, TCP);
 		esix_sockets[sock].state = SYN_SENT;
+		esix_socket_hash(sock);
+		esix_socket_ready(sock);
+
+		//send a SYN packet, it takes a sequence number
+		esix_tcp_send_segment(sock, esix_sockets[sock].seqn, SYN, NULL, 0);
+		esix_sockets[sock].seqn++;
+		esix_sockets[sock].ctl_date = esix_get_time();
+		esix_sockets[sock].rexmit_date = esix_get_time() + 2;
+
+#if ESIX_BLOCKING
+		//wait for the handshake, the attempt goes on past SO_SNDTIMEO
+		start = esix_get_time_ms();
+		while(esix_sockets[sock].state == SYN_SENT)
+			if(esix_socket_wait(sock, esix_sockets[sock].snd_timeo, start) < 0)
+				return -1;
 
-		//send a SYN packet
-		esix_tcp_send(&esix_sockets[sock].laddr, &esix_sockets[sock].raddr, 
-			esix_sockets[sock].lport, esix_sockets[sock].rport, 
-			esix_sockets[sock].seqn+1, esix_sockets[sock].ackn, SYN, NULL, 0);
+		if(esix_sockets[sock].state != ESTABLISHED &&
+			esix_sockets[sock].state != CLOSE_WAIT)
+			return -1;
+#endif
 	}
 	else if(esix_sockets[sock].proto == SOCK_DGRAM)
 	{
@@ -141,11 +364,21 @@ int connect(int sock, const struct sockaddr_in6 *daddr, int len)
 			esix_sockets[sock].state != ESTABLISHED)
 			return -1;
 
+		if((i=esix_intf_pick_source_address((struct ip6_addr*) &daddr->sin6_addr)) < 0)
+			return -1;
+
 		//this puts us in so called udp connected mode
 		//only the source addr & port can talk to this socket
+		esix_socket_unhash(sock);
+		if(esix_memcmp(&esix_sockets[sock].laddr, &in6addr_any, 16) == 0)
+			esix_memcpy(&esix_sockets[sock].laddr, &addrs[i]->addr, 16);
 		esix_sockets[sock].rport = daddr->sin6_port;
 		esix_memcpy(&esix_sockets[sock].raddr, &daddr->sin6_addr, 16);
+		esix_ip_tmpl_init(&esix_sockets[sock].tmpl, &esix_sockets[sock].laddr,
+			&esix_sockets[sock].raddr, DEFAULT_TTL, UDP);
 		esix_sockets[sock].state = ESTABLISHED;
+		esix_socket_hash(sock);
+		esix_socket_ready(sock);
 	}
 	else return -1;
 
@@ -195,35 +428,132 @@ int recv(int sock, void *buf, int max_len, u8_t flags)
 	return recvfrom(sock, buf, max_len, flags, NULL, NULL);
 }
 
-int recvfrom(int sock, void *buf, int max_len, int flags, struct sockaddr_in6 *sockaddr, int *sockaddr_len)
+//takes the first datagram out of a UDP socket queue. Returns its length,
+//or -1 if there's none.
+static int esix_socket_take_dgram(int sock, void *buf, int max_len, int flags, struct sockaddr_in6 *sockaddr)
 {
-	//TODO : watch lockups due to OOM
 	int len;
+	struct sock_queue *sqe;
+	struct esix_dgram *d;
 
-	if(esix_sockets[sock].proto == SOCK_STREAM && esix_sockets[sock].state != ESTABLISHED)
+	//MSG_PEEK leaves it in the queue for the next call
+	if((sqe = esix_socket_find_e(sock, RECV_PKT,
+		(flags & MSG_PEEK) ? KEEP : EVICT)) == NULL)
 		return -1;
+	d = sqe->data;
 
-	struct sock_queue *sqe = esix_socket_find_e(sock, RECV_PKT, EVICT); 
-	if(sqe == NULL)
-		return 0;
-
-	//TODO : hmm data loss warning here
+	//what doesn't fit is lost, MSG_TRUNC tells how much there was
 	if(max_len < sqe->data_len)
 		len = max_len;
 	else
 		len = sqe->data_len;
 
+	//copy the sockaddr_in6 struct
+	if(sockaddr != NULL)
+		esix_memcpy(sockaddr, &d->from, sizeof(struct sockaddr_in6));
+	//actual data
+	esix_memcpy(buf, d + 1, len);
+
+	if(flags & MSG_TRUNC)
+		len = sqe->data_len;
+
+	//free data buffer and socket queue element
+	if(!(flags & MSG_PEEK))
+	{
+		esix_sockets[sock].rcv_queued -= sqe->data_len;
+		esix_socket_dgram_put(d);
+		esix_w_free(sqe);
+	}
+	return len;
+}
+
+//waits for a datagram to be queued, unless MSG_DONTWAIT
+static void esix_socket_wait_dgram(int sock, int flags)
+{
+	u32_t start = esix_get_time_ms();
+
+	while(!(flags & MSG_DONTWAIT) && esix_sockets[sock].state != CLOSED &&
+		esix_sockets[sock].queue == NULL)
+		if(esix_socket_wait(sock, esix_sockets[sock].rcv_timeo, start) < 0)
+			break;
+}
+
+int recvfrom(int sock, void *buf, int max_len, int flags, struct sockaddr_in6 *sockaddr, int *sockaddr_len)
+{
+	//TODO : watch lockups due to OOM
+	int len, n;
+	u16_t wnd;
+	struct esix_ring *ring = &esix_sockets[sock].rcv_ring;
+	u32_t start = esix_get_time_ms();
+
+	//what arrived before the peer's FIN can still be read
+	if(esix_sockets[sock].proto == SOCK_STREAM && esix_sockets[sock].state != ESTABLISHED &&
+		esix_sockets[sock].state != CLOSE_WAIT)
+		return -1;
+
+	//wait for something to read, or for the peer to close
+	while(!(flags & MSG_DONTWAIT) && esix_sockets[sock].state != CLOSED &&
+		(esix_sockets[sock].proto == SOCK_DGRAM ? esix_sockets[sock].queue == NULL :
+		esix_sockets[sock].rcv_ring.len == 0 && esix_sockets[sock].state == ESTABLISHED))
+		if(esix_socket_wait(sock, esix_sockets[sock].rcv_timeo, start) < 0)
+			break;
+
 	switch(esix_sockets[sock].proto)
 	{
 		case SOCK_DGRAM:
-			//copy the sockaddr_in6 struct
-			if(sockaddr != NULL)
-				esix_memcpy(sockaddr, sqe->data, sizeof(struct sockaddr_in6));
-			//actual data
-			esix_memcpy(buf, sqe->data+sizeof(struct sockaddr_in6), len);
+			if((len = esix_socket_take_dgram(sock, buf, max_len, flags, sockaddr)) < 0)
+				return 0;
 		break;
 
 		case SOCK_STREAM:
+			//the byte stream has no boundaries, take as much as we can.
+			//MSG_PEEK leaves it in the ring, MSG_TRUNC drops it without
+			//copying it and MSG_WAITALL keeps at it until there's max_len.
+			len = 0;
+			while(1)
+			{
+				if(flags & MSG_PEEK)
+				{
+					//peeking always starts over from the head of the ring
+					if((n = ring->len) > max_len)
+						n = max_len;
+					if(n > 0)
+						esix_ring_get(ring, 0, buf, n);
+					len = n;
+
+					//no reading any further than a full ring
+					if(ring->len == ring->size)
+						break;
+				}
+				else
+				{
+					if((n = ring->len) > max_len - len)
+						n = max_len - len;
+
+					if(n > 0)
+					{
+						wnd = ring->size - ring->len;
+						if(flags & MSG_TRUNC)
+							esix_ring_drop(ring, n);
+						else
+							esix_ring_read(ring, (u8_t *) buf + len, n);
+						len += n;
+
+						//let the peer know if its window opened up
+						esix_tcp_window_update(sock, wnd);
+					}
+				}
+
+				if(!(flags & MSG_WAITALL) || len == max_len || (flags & MSG_DONTWAIT) ||
+					esix_sockets[sock].state != ESTABLISHED ||
+					esix_socket_wait(sock, esix_sockets[sock].rcv_timeo, start) < 0)
+					break;
+			}
+
+			//the peer closed the connection and we read everything
+			if(len == 0)
+				return esix_sockets[sock].state == ESTABLISHED ? 0 : -1;
+
 			//fill up the sockaddr_in6 struct with socket info
 			//as TCP can only receive data in connected state
 			if(sockaddr != NULL)
@@ -231,196 +561,575 @@ int recvfrom(int sock, void *buf, int max_len, int flags, struct sockaddr_in6 *s
 				sockaddr->sin6_port = esix_sockets[sock].rport;
 				esix_memcpy(&sockaddr->sin6_addr, &esix_sockets[sock].raddr, 16);
 			}
-			//actual data
-			esix_memcpy(buf, sqe->data, len);
 		break;
+
+		default:
+			return -1;
 	}
 
 	if(sockaddr_len != NULL)
 		*sockaddr_len = sizeof(struct sockaddr_in6);
 
-	//free data buffer and socket queue element
-	esix_w_free(sqe->data);
-	esix_w_free(sqe);
+	esix_socket_ready(sock);
+	return len;
+}
+
+int recvmmsg(int sock, struct mmsghdr *msgs, int vlen, u8_t flags)
+{
+	int i, len;
+
+	if(esix_sockets[sock].proto != SOCK_DGRAM)
+		return -1;
+
+	//only wait for the first one, then take what's there
+	esix_socket_wait_dgram(sock, flags);
+
+	for(i = 0; i < vlen; i++)
+	{
+		if((len = esix_socket_take_dgram(sock, msgs[i].msg_buf, msgs[i].msg_size,
+			flags & MSG_TRUNC, &msgs[i].msg_name)) < 0)
+			break;
+		msgs[i].msg_len = len;
+	}
 
+	esix_socket_ready(sock);
+	return i;
+}
+
+int recv_zc(int sock, void **data, struct sockaddr_in6 *from, u8_t flags)
+{
+	int len;
+	struct sock_queue *sqe;
+	struct esix_dgram *d;
+
+	if(esix_sockets[sock].proto != SOCK_DGRAM || data == NULL)
+		return -1;
+
+	*data = NULL;
+	esix_socket_wait_dgram(sock, flags);
+	if((sqe = esix_socket_find_e(sock, RECV_PKT, EVICT)) == NULL)
+		return 0;
+
+	//the payload goes as is, its buffer with it
+	d = sqe->data;
+	len = sqe->data_len;
+	if(from != NULL)
+		esix_memcpy(from, &d->from, sizeof(struct sockaddr_in6));
+	*data = d + 1;
+
+	esix_sockets[sock].rcv_queued -= len;
+	esix_w_free(sqe);
+	esix_socket_ready(sock);
 	return len;
 }
 
+void release(void *data)
+{
+	if(data != NULL)
+		esix_socket_dgram_put((struct esix_dgram *) data - 1);
+}
+
 int accept(int sock, struct sockaddr_in6 *saddr, int *sockaddr_len)
 {
 	int session_sock;
-	struct sock_queue *sqe = esix_socket_find_e(sock, CHILD_SOCK, EVICT); 
-	if(sqe == NULL)
+	u32_t start = esix_get_time_ms();
+
+	if(esix_sockets[sock].state != LISTEN)
 		return -1;
 
-	session_sock = sqe->socknum;
-	esix_w_free(sqe);
+	//connections reset before we got to them are just released
+	do
+	{
+		//wait for one, for as long as SO_RCVTIMEO allows
+		while((session_sock = esix_sockets[sock].accept_head) < 0)
+			if(esix_sockets[sock].state != LISTEN ||
+				esix_socket_wait(sock, esix_sockets[sock].rcv_timeo, start) < 0)
+				return -1;
+
+		esix_sockets[sock].accept_head = esix_sockets[session_sock].accept_next;
+		esix_sockets[sock].accept_len--;
+		esix_sockets[session_sock].flags &= ~SOCK_QUEUED;
+	} while(esix_sockets[session_sock].state == CLOSED);
+	esix_socket_ready(sock);
 
 	if(saddr != NULL)
 	{
-		esix_memcpy(&saddr->sin6_addr, &esix_sockets[sock].raddr, 16);
-		saddr->sin6_port = esix_sockets[sock].rport;
+		esix_memcpy(&saddr->sin6_addr, &esix_sockets[session_sock].raddr, 16);
+		saddr->sin6_port = esix_sockets[session_sock].rport;
 	}
 
 	return session_sock;
 }
 
-//creates a session socket (actually only used by TCP when accept()'ing a client connection)
-int esix_socket_create_child(const struct ip6_addr *saddr, const struct ip6_addr *daddr, u16_t sport, u16_t dport, u8_t proto)
+//creates a session socket (actually only used by TCP when a passive open completes)
+//and appends it to the accept queue of the listening socket.
+int esix_socket_create_child(int server_sock, const struct ip6_addr *saddr, const struct ip6_addr *daddr, u16_t sport, u16_t dport)
 {
-	struct sock_queue *sqe, *cur_sqe;
-	//check if we're actually listening, if we are, create a new socket entry,
-	//flag it as established and return its socket descriptor.
-	int server_sock, session_sock;
+	int session_sock, *last;
 
-	if((server_sock = esix_find_socket(saddr, daddr, sport, dport, proto, FIND_LISTEN)) < 0)
+	if(esix_sockets[server_sock].accept_len >= esix_sockets[server_sock].backlog)
 		return -1;
 
 	//we found the server socket. try to create a service socket
-	if((session_sock = socket(AF_INET6, proto, 0)) < 0)
+	if((session_sock = socket(AF_INET6, esix_sockets[server_sock].proto, 0)) < 0)
 		return -1;
 
-	if((sqe = esix_w_malloc(sizeof(struct sock_queue))) == NULL)
+	//the connection gets the buffer sizes and keepalive settings of the listener
+	esix_sockets[session_sock].snd_size = esix_sockets[server_sock].snd_size;
+	esix_sockets[session_sock].rcv_size = esix_sockets[server_sock].rcv_size;
+	esix_sockets[session_sock].flags |= esix_sockets[server_sock].flags & SOCK_KEEPALIVE;
+	esix_sockets[session_sock].keep_idle = esix_sockets[server_sock].keep_idle;
+	esix_sockets[session_sock].keep_intvl = esix_sockets[server_sock].keep_intvl;
+	esix_sockets[session_sock].keep_cnt = esix_sockets[server_sock].keep_cnt;
+	esix_sockets[session_sock].idle_timeout = esix_sockets[server_sock].idle_timeout;
+	esix_sockets[session_sock].rcv_timeo = esix_sockets[server_sock].rcv_timeo;
+	esix_sockets[session_sock].snd_timeo = esix_sockets[server_sock].snd_timeo;
+	esix_sockets[session_sock].cb = esix_sockets[server_sock].cb;
+	esix_sockets[session_sock].cb_arg = esix_sockets[server_sock].cb_arg;
+	if(esix_socket_alloc_rings(session_sock) < 0)
 	{
-		esix_sockets[session_sock].state = CLOSED;
+		esix_socket_release(session_sock);
 		return -1;
 	}
 
-	//there's no element in the list.
-	if(esix_sockets[server_sock].queue == NULL)
-		esix_sockets[server_sock].queue = sqe;
-	else
-	{
-		//find the end of the list
-		cur_sqe = esix_sockets[server_sock].queue;
-		while(cur_sqe->next_e != NULL)
-			cur_sqe = cur_sqe->next_e;
-		cur_sqe->next_e	= sqe;
-	}
-
-	sqe->qe_type = CHILD_SOCK;
-	sqe->socknum = session_sock;
-	sqe->next_e  = NULL;
+	//find the end of the accept queue
+	last = &esix_sockets[server_sock].accept_head;
+	while(*last >= 0)
+		last = &esix_sockets[*last].accept_next;
+	*last = session_sock;
+	esix_sockets[session_sock].accept_next = -1;
+	esix_sockets[session_sock].flags |= SOCK_QUEUED;
+	esix_sockets[server_sock].accept_len++;
 	
 	//copy remote addr stuff
 	esix_memcpy(&esix_sockets[session_sock].raddr, saddr, 16);
 	esix_sockets[session_sock].rport = sport;
-	esix_sockets[session_sock].proto = proto;
 	esix_memcpy(&esix_sockets[session_sock].laddr, daddr, 16);
-	esix_sockets[session_sock].lport = dport;
+	esix_socket_set_port(session_sock, dport);
+	esix_ip_tmpl_init(&esix_sockets[session_sock].tmpl, daddr, saddr, DEFAULT_TTL, TCP);
 	esix_sockets[session_sock].state = SYN_RECEIVED;
+	esix_socket_hash(session_sock);
+	esix_socket_wake(server_sock);
 
 	return session_sock;
 }
 
-int esix_find_socket(const struct ip6_addr *saddr, const struct ip6_addr *daddr, u16_t sport, u16_t dport, u8_t proto, u8_t mask)
+//returns a free half-open connection entry for a listening socket,
+//or -1 if its backlog or the table is full.
+int esix_socket_new_syn(int server_sock)
 {
-	int i=0;
-	while(i<ESIX_MAX_SOCK)
+	int i, free_syn = -1, n = esix_sockets[server_sock].accept_len;
+
+	for(i=0; i<ESIX_MAX_SYN; i++)
 	{
-		//loop through the socket table until we find a match
-		//first, look at protocol and port numbers.
-		//then, let's see if either the packet was sent to the socket's 
-		//local address or if the socket is listening on all interfaces
-		if(esix_sockets[i].proto == proto && esix_sockets[i].lport == dport &&
-			((esix_memcmp(daddr, &esix_sockets[i].laddr, 16) == 0) ||
-			(esix_memcmp(&esix_sockets[i].laddr, &in6addr_any, 16) == 0)))
-		{
-			switch(mask)
-			{
-				case FIND_ANY:
-					return i;
-				break;
+		if(esix_syn_table[i].rexmit_date == 0)
+			free_syn = i;
+		else if(esix_syn_table[i].listener == server_sock)
+			n++;
+	}
 
-				case FIND_LISTEN:
-					if(esix_sockets[i].state == LISTEN)
-						return i;
-				break;
+	if(n >= esix_sockets[server_sock].backlog)
+		return -1;
 
-				case FIND_CONNECTED:
-					if(esix_sockets[i].state != CLOSED &&
-						esix_sockets[i].state != RESERVED &&
-						(esix_memcmp(&esix_sockets[i].raddr, saddr, 16) == 0) &&
-						esix_sockets[i].rport == sport)
-						return i;
-				break;
-			}
-	
-		}  
-		i++;
-	}
-	//we couldn't find any socket capable of handling this packet.
-	return -1;
+	if(free_syn >= 0)
+		esix_syn_table[free_syn].listener = server_sock;
+	return free_syn;
 }
 
-int socket(const int family, const u8_t type, const u8_t proto)
+//returns the half-open connection entry of a connection, or -1
+int esix_socket_find_syn(const struct ip6_addr *saddr, const struct ip6_addr *daddr, u16_t sport, u16_t dport)
 {
 	int i;
-	//TODO : allow the same socket number on TCP & UDP
-
-	//we only support inet6
-	if(family != AF_INET6)
-		return -1;
-
-	//find a free port number
-	while(1)
-	{
-		if(++esix_last_port > LAST_PORT || esix_last_port < FIRST_PORT)
-			esix_last_port = FIRST_PORT;
-
-		if(esix_port_available(esix_last_port) == 0)
-			break;
-	}
-
-	//find a free socket number
-	i=0;
-	while(i<ESIX_MAX_SOCK)
-	{
-		//we found a free socket holder
-		if(esix_sockets[i].state == CLOSED)
-		{
-			esix_sockets[i].state = RESERVED;
-			esix_sockets[i].proto = type; //mmmm...
-			esix_sockets[i].lport = esix_last_port;
-			esix_sockets[i].rport = 0;
-			esix_memcpy(&esix_sockets[i].laddr, &in6addr_any, 16);
-			esix_memcpy(&esix_sockets[i].raddr, &in6addr_any, 16);
-			esix_sockets[i].seqn = 0; //TODO : should be random
-			esix_sockets[i].ackn = 0;
-			esix_sockets[i].rexmit_date = 0;
-			esix_sockets[i].queue = NULL;
 
+	for(i=0; i<ESIX_MAX_SYN; i++)
+		if(esix_syn_table[i].rexmit_date != 0 &&
+			esix_syn_table[i].lport == dport &&
+			esix_syn_table[i].rport == sport &&
+			esix_memcmp(&esix_syn_table[i].raddr, saddr, 16) == 0 &&
+			esix_memcmp(&esix_syn_table[i].laddr, daddr, 16) == 0)
 			return i;
-		}
-		i++;
-	}
 
-	//the socket table is most likely full
-	uart_printf("socket : ressource temp. unavailable\n");
 	return -1;
 }
 
-int bind(const int socknum, const struct sockaddr_in6 *sockaddr, const int len)
+static int esix_socket_conn_bucket(const struct ip6_addr *laddr, const struct ip6_addr *raddr, u16_t lport, u16_t rport, u8_t proto)
 {
-	int i=0;
-	if(len != sizeof(struct sockaddr_in6))
-		return -1;
+	u32_t h, ports = (lport << 16) | rport;
 
-	//loop through the socket list to find if the port is available
-	while(i<ESIX_MAX_SOCK)
+	h = esix_hash(laddr, 16, esix_socket_hash_seed ^ proto);
+	h = esix_hash(raddr, 16, h);
+	h = esix_hash(&ports, 4, h);
+
+	return h & (ESIX_SOCK_HASH-1);
+}
+
+static int esix_socket_port_bucket(u16_t lport, u8_t proto)
+{
+	u32_t key = (proto << 16) | lport;
+
+	return esix_hash(&key, 4, esix_socket_hash_seed) & (ESIX_SOCK_HASH-1);
+}
+
+//links a socket in the lookup table matching its state.
+//sockets that are neither listening nor connected aren't reachable.
+void esix_socket_hash(int s)
+{
+	int *bucket;
+
+	if(esix_sockets[s].flags & SOCK_HASHED ||
+		esix_sockets[s].state == CLOSED || esix_sockets[s].state == RESERVED)
+		return;
+
+	if(esix_sockets[s].state == LISTEN)
+		bucket = &esix_listen_hash[esix_socket_port_bucket(
+			esix_sockets[s].lport, esix_sockets[s].proto)];
+	else
+		bucket = &esix_conn_hash[esix_socket_conn_bucket(&esix_sockets[s].laddr,
+			&esix_sockets[s].raddr, esix_sockets[s].lport,
+			esix_sockets[s].rport, esix_sockets[s].proto)];
+
+	esix_sockets[s].hash_next = *bucket;
+	*bucket = s;
+	esix_sockets[s].flags |= SOCK_HASHED;
+}
+
+//unlinks a socket from its lookup table, must be called before
+//its state or addresses change
+void esix_socket_unhash(int s)
+{
+	int *cur;
+
+	if(!(esix_sockets[s].flags & SOCK_HASHED))
+		return;
+
+	if(esix_sockets[s].state == LISTEN)
+		cur = &esix_listen_hash[esix_socket_port_bucket(
+			esix_sockets[s].lport, esix_sockets[s].proto)];
+	else
+		cur = &esix_conn_hash[esix_socket_conn_bucket(&esix_sockets[s].laddr,
+			&esix_sockets[s].raddr, esix_sockets[s].lport,
+			esix_sockets[s].rport, esix_sockets[s].proto)];
+
+	while(*cur >= 0 && *cur != s)
+		cur = &esix_sockets[*cur].hash_next;
+	if(*cur == s)
+		*cur = esix_sockets[s].hash_next;
+
+	esix_sockets[s].flags &= ~SOCK_HASHED;
+}
+
+//unlinks an open socket from esix_port_hash
+static void esix_socket_port_unlink(int s)
+{
+	int *cur = &esix_port_hash[esix_socket_port_bucket(
+		esix_sockets[s].lport, esix_sockets[s].proto)];
+
+	while(*cur >= 0 && *cur != s)
+		cur = &esix_sockets[*cur].port_next;
+	if(*cur == s)
+		*cur = esix_sockets[s].port_next;
+}
+
+//moves an open socket to another local port (network byte order)
+void esix_socket_set_port(int s, u16_t lport)
+{
+	int *bucket;
+
+	esix_socket_port_unlink(s);
+	esix_sockets[s].lport = lport;
+
+	bucket = &esix_port_hash[esix_socket_port_bucket(lport, esix_sockets[s].proto)];
+	esix_sockets[s].port_next = *bucket;
+	*bucket = s;
+}
+
+//makes a socket a member of a multicast group. the interface joins it
+//(sending an MLD report) along with the first socket.
+static int esix_socket_join(int s, const struct ip6_addr *group)
+{
+	int i, m = -1, added = 1;
+
+	for(i = 0; i < ESIX_MAX_MSHIP; i++)
+	{
+		if(esix_mships[i].sock < 0)
+		{
+			if(m < 0)
+				m = i;
+		}
+		else if(esix_memcmp(&esix_mships[i].group, group, 16) == 0)
+		{
+			if(esix_mships[i].sock == s)
+				return -1;
+			added = 0;
+		}
+	}
+
+	if(m < 0)
+		return -1;
+
+	//groups the stack is in for itself (all-nodes, solicited-node)
+	//are left alone
+	if(added && esix_intf_get_address_index(group, MULTICAST, 0x80) >= 0)
+		added = 0;
+	else if(added && !esix_intf_add_address((struct ip6_addr *) group, 0x80, 0, MULTICAST))
+		return -1;
+
+	esix_mships[m].group = *group;
+	esix_mships[m].sock = s;
+	esix_mships[m].added = added;
+	return 0;
+}
+
+//ends a membership. the interface leaves the group (sending an MLD
+//done) along with the last socket.
+static void esix_socket_drop_mship(int m)
+{
+	int i;
+
+	esix_mships[m].sock = -1;
+	if(!esix_mships[m].added)
+		return;
+
+	for(i = 0; i < ESIX_MAX_MSHIP; i++)
+		if(esix_mships[i].sock >= 0 &&
+			esix_memcmp(&esix_mships[i].group, &esix_mships[m].group, 16) == 0)
+		{
+			esix_mships[i].added = 1;
+			return;
+		}
+
+	esix_intf_remove_address(&esix_mships[m].group, MULTICAST, 0x80);
+}
+
+//makes a socket leave a multicast group, or all of them if group is NULL
+static int esix_socket_leave(int s, const struct ip6_addr *group)
+{
+	int i, ret = -1;
+
+	for(i = 0; i < ESIX_MAX_MSHIP; i++)
+		if(esix_mships[i].sock == s && (group == NULL ||
+			esix_memcmp(&esix_mships[i].group, group, 16) == 0))
+		{
+			esix_socket_drop_mship(i);
+			ret = 0;
+		}
+	return ret;
+}
+
+//frees everything a socket holds and makes its slot available
+void esix_socket_release(int s)
+{
+	if(esix_sockets[s].state != CLOSED)
+		esix_socket_port_unlink(s);
+	esix_socket_leave(s, NULL);
+	esix_socket_unhash(s);
+	esix_socket_free_queue(s);
+	esix_timer_stop(&esix_sockets[s].keep_timer);
+	esix_sockets[s].state = CLOSED;
+	esix_socket_wake(s);
+}
+
+int esix_find_socket(const struct ip6_addr *saddr, const struct ip6_addr *daddr, u16_t sport, u16_t dport, u8_t proto, u8_t mask)
+{
+	int i, wildcard = -1;
+
+	//a connected socket has to match the whole 4-tuple
+	if(mask != FIND_LISTEN)
+	{
+		i = esix_conn_hash[esix_socket_conn_bucket(daddr, saddr, dport, sport, proto)];
+		for(; i >= 0; i = esix_sockets[i].hash_next)
+			if(esix_sockets[i].proto == proto &&
+				esix_sockets[i].lport == dport &&
+				esix_sockets[i].rport == sport &&
+				esix_memcmp(&esix_sockets[i].raddr, saddr, 16) == 0 &&
+				esix_memcmp(&esix_sockets[i].laddr, daddr, 16) == 0)
+				return i;
+	}
+
+	if(mask == FIND_CONNECTED)
+		return -1;
+
+	//a listener bound to the destination address wins over
+	//one listening on all interfaces
+	i = esix_listen_hash[esix_socket_port_bucket(dport, proto)];
+	for(; i >= 0; i = esix_sockets[i].hash_next)
+	{
+		if(esix_sockets[i].proto != proto || esix_sockets[i].lport != dport)
+			continue;
+
+		if(esix_memcmp(&esix_sockets[i].laddr, daddr, 16) == 0)
+			return i;
+		if(wildcard < 0 && esix_memcmp(&esix_sockets[i].laddr, &in6addr_any, 16) == 0)
+			wildcard = i;
+	}
+
+	//we couldn't find any socket capable of handling this packet.
+	return wildcard;
+}
+
+//hands a multicast datagram to every udp socket bound to its port and
+//group (or to all addresses). they share a single copy of it.
+//returns the number of sockets it went to.
+int esix_queue_mcast(const struct ip6_addr *daddr, u16_t dport, const void *data, int len, struct sockaddr_in6 *sockaddr)
+{
+	int i, next, n = 0;
+	struct esix_dgram *d = NULL;
+	//the headers it's in can be overwritten by the first delivery
+	struct ip6_addr group = *daddr;
+
+	for(i = esix_listen_hash[esix_socket_port_bucket(dport, SOCK_DGRAM)]; i >= 0; i = next)
+	{
+		//raw API callbacks can close the socket
+		next = esix_sockets[i].hash_next;
+
+		if(esix_sockets[i].proto != SOCK_DGRAM || esix_sockets[i].lport != dport ||
+			(esix_memcmp(&esix_sockets[i].laddr, &group, 16) != 0 &&
+			esix_memcmp(&esix_sockets[i].laddr, &in6addr_any, 16) != 0))
+			continue;
+
+		if(esix_socket_raw_recv(i, data, len, sockaddr) >= 0 ||
+			esix_socket_deliver(i, &d, data, len, sockaddr) >= 0)
+			n++;
+	}
+
+	//nobody kept it
+	if(d != NULL && d->refs == 0)
+		esix_w_free(d->buf);
+	return n;
+}
+
+int socket(const int family, const u8_t type, const u8_t proto)
+{
+	int i, count = LAST_PORT - FIRST_PORT + 1;
+	u16_t port;
+
+	//we only support inet6
+	if(family != AF_INET6)
+		return -1;
+
+	//find a free port number : start from a random one so that it
+	//can't be guessed, then take the next free one (RFC 6056 algorithm 1).
+	//TCP and UDP ports are counted apart.
+	port = FIRST_PORT + esix_random() % count;
+	while(esix_port_available(hton16(port), type) < 0)
 	{
-		if(esix_sockets[i].state != CLOSED &&
-			esix_sockets[i].lport == sockaddr->sin6_port)
+		if(--count == 0)
 			return -1;
+		port = (port == LAST_PORT) ? FIRST_PORT : port + 1;
+	}
+
+	//find a free socket number
+	i=0;
+	while(i<ESIX_MAX_SOCK)
+	{
+		//we found a free socket holder
+		if(esix_sockets[i].state == CLOSED &&
+			!(esix_sockets[i].flags & SOCK_QUEUED))
+		{
+			esix_sockets[i].state = RESERVED;
+			esix_sockets[i].proto = type; //mmmm...
+			esix_socket_set_port(i, hton16(port));
+			esix_sockets[i].rport = 0;
+			esix_memcpy(&esix_sockets[i].laddr, &in6addr_any, 16);
+			esix_memcpy(&esix_sockets[i].raddr, &in6addr_any, 16);
+			esix_sockets[i].seqn = esix_random();
+			esix_sockets[i].snd_una = esix_sockets[i].seqn;
+			esix_sockets[i].snd_date = 0;
+			esix_sockets[i].rexmit_high = esix_sockets[i].seqn;
+			esix_sockets[i].ecn_recover = esix_sockets[i].seqn;
+			esix_sockets[i].sack_n = 0;
+			esix_sockets[i].ooo_n = 0;
+			esix_sockets[i].ackn = 0;
+			esix_sockets[i].rexmit_date = 0;
+			esix_sockets[i].ctl_date = 0;
+			esix_sockets[i].rexmits = 0;
+			esix_sockets[i].flags = 0;
+			esix_sockets[i].sack_last = 0;
+			esix_sockets[i].unacked_segs = 0;
+			esix_sockets[i].mss = TCP_DEFAULT_MSS;
+			esix_sockets[i].snd_wnd = TCP_DEFAULT_MSS;
+			esix_sockets[i].cwnd = TCP_INIT_CWND(TCP_DEFAULT_MSS);
+			esix_sockets[i].ssthresh = 0xffffffff;
+			esix_timer_stop(&esix_sockets[i].delack_timer);
+			esix_timer_init(&esix_sockets[i].delack_timer, esix_tcp_delack_timeout, i);
+			esix_timer_stop(&esix_sockets[i].cork_timer);
+			esix_timer_init(&esix_sockets[i].cork_timer, esix_tcp_cork_timeout, i);
+			esix_sockets[i].rcv_date = esix_get_time();
+			esix_timer_stop(&esix_sockets[i].keep_timer);
+			esix_timer_init(&esix_sockets[i].keep_timer, esix_socket_keepalive, i);
+			esix_sockets[i].keep_idle = ESIX_KEEPIDLE;
+			esix_sockets[i].keep_intvl = ESIX_KEEPINTVL;
+			esix_sockets[i].keep_cnt = ESIX_KEEPCNT;
+			esix_sockets[i].keep_probes = 0;
+			esix_sockets[i].idle_timeout = 0;
+			esix_sockets[i].rcv_timeo = 0;
+			esix_sockets[i].snd_timeo = 0;
+			esix_sockets[i].backlog = 0;
+			esix_sockets[i].accept_len = 0;
+			esix_sockets[i].accept_head = -1;
+			esix_sockets[i].accept_next = -1;
+			esix_sockets[i].snd_size = ESIX_SNDBUF;
+			esix_sockets[i].rcv_size = (type == SOCK_DGRAM) ? ESIX_UDP_RCVBUF : ESIX_RCVBUF;
+			esix_socket_clear_rings(i);
+			esix_sockets[i].sref = NULL;
+			esix_sockets[i].sref_len = 0;
+			esix_sockets[i].rtx_len = 0;
+			esix_sockets[i].queue = NULL;
+			esix_sockets[i].rcv_queued = 0;
+			esix_sockets[i].rcv_drops = 0;
+			esix_sockets[i].cb = NULL;
+			esix_sockets[i].cb_arg = NULL;
+			esix_sockets[i].ready_edge = 0;
+			esix_socket_ready(i);
+
+			return i;
+		}
 		i++;
 	}
 
+	//the socket table is most likely full
+	uart_printf("socket : ressource temp. unavailable\n");
+	return -1;
+}
+
+//a udp port can be shared by sockets that all set SO_REUSEADDR
+//(several tasks listening to the same multicast group)
+static int esix_port_shared(int s, u16_t port)
+{
+	int i;
+
+	if(esix_sockets[s].proto != SOCK_DGRAM || !(esix_sockets[s].flags & SOCK_REUSEADDR))
+		return -1;
+
+	i = esix_port_hash[esix_socket_port_bucket(port, SOCK_DGRAM)];
+	for(; i >= 0; i = esix_sockets[i].port_next)
+		if(esix_sockets[i].proto == SOCK_DGRAM && esix_sockets[i].lport == port &&
+			!(esix_sockets[i].flags & SOCK_REUSEADDR))
+			return -1;
+	return 0;
+}
+
+int bind(const int socknum, const struct sockaddr_in6 *sockaddr, const int len)
+{
+	int i=0;
+	if(len != sizeof(struct sockaddr_in6))
+		return -1;
+
+	//it's too late once the socket is listening or connected
+	if(esix_sockets[socknum].flags & SOCK_HASHED)
+		return -1;
+
+	//the port can't be taken by another socket of the same protocol
+	if(sockaddr->sin6_port != esix_sockets[socknum].lport &&
+		esix_port_available(sockaddr->sin6_port, esix_sockets[socknum].proto) < 0 &&
+		esix_port_shared(socknum, sockaddr->sin6_port) < 0)
+		return -1;
 
 	//now check that we actually own the requested adress
 	//if it's all zeroes, OK
 	if(esix_memcmp(&in6addr_any, &sockaddr->sin6_addr, 16) == 0)
 	{
-		esix_sockets[socknum].lport = sockaddr->sin6_port;
+		esix_socket_set_port(socknum, sockaddr->sin6_port);
 		esix_memcpy(&esix_sockets[socknum].laddr, &in6addr_any, 16);
 		return 0;
 	}
@@ -432,21 +1141,30 @@ int bind(const int socknum, const struct sockaddr_in6 *sockaddr, const int len)
 			if(addrs[i] != NULL &&
 				esix_memcmp(&addrs[i]->addr, &sockaddr->sin6_addr, 16) == 0)
 			{
-				esix_sockets[socknum].lport = sockaddr->sin6_port;
-				esix_memcpy(&addrs[i]->addr, &sockaddr->sin6_addr, 16);
+				esix_socket_set_port(socknum, sockaddr->sin6_port);
+				esix_memcpy(&esix_sockets[socknum].laddr, &sockaddr->sin6_addr, 16);
 				return 0;
 			} 
+			i++;
 		}
 	}
 	return -1;
 
 }
 
-int listen(int socket, int blacklog)
+int listen(int socket, int backlog)
 {
 	if(esix_sockets[socket].state == RESERVED)
 	{
+		if(backlog < 1)
+			backlog = 1;
+		if(backlog > ESIX_MAX_SOCK)
+			backlog = ESIX_MAX_SOCK;
+
+		esix_sockets[socket].backlog = backlog;
 		esix_sockets[socket].state = LISTEN;
+		esix_socket_hash(socket);
+		esix_socket_ready(socket);
 		return 0;
 	}
 	return -1;
@@ -454,35 +1172,61 @@ int listen(int socket, int blacklog)
 
 int close(const int socknum)
 {
+	int i;
+
 	if(esix_sockets[socknum].state == CLOSED || 
-		esix_sockets[socknum].state == CLOSING)
+		(esix_sockets[socknum].flags & SOCK_FIN_QUEUED))
 		return -1;
 
 	if(esix_sockets[socknum].proto == SOCK_STREAM)
 	{
 		switch(esix_sockets[socknum].state)
 		{
-			//FIXME : this is way too harsh
-			case SYN_SENT:
-			case SYN_RECEIVED:
-			case CLOSING:
+			//nobody is going to read what we received. the socket stays
+			//around until the queued data and our FIN are acknowledged.
 			case ESTABLISHED:
-				esix_tcp_send(&esix_sockets[socknum].laddr, 
-						&esix_sockets[socknum].raddr,
-						esix_sockets[socknum].lport,
-						esix_sockets[socknum].rport,
-						esix_sockets[socknum].seqn,
-						esix_sockets[socknum].ackn,
-							RST|ACK, NULL, 0);
+			case CLOSE_WAIT:
+				esix_ring_drop(&esix_sockets[socknum].rcv_ring, esix_sockets[socknum].rcv_ring.len);
+				esix_sockets[socknum].ooo_n = 0;
+
+				if(esix_sockets[socknum].state == ESTABLISHED)
+					esix_sockets[socknum].state = FIN_WAIT_1;
+				else
+					esix_sockets[socknum].state = LAST_ACK;
+
+				esix_sockets[socknum].flags |= SOCK_FIN_QUEUED;
+				esix_tcp_output(socknum, 1);
+			return 0;
+
+			//we didn't send anything yet, just abort
+			case SYN_RECEIVED:
+				esix_tcp_send_segment(socknum, esix_sockets[socknum].seqn, RST|ACK, NULL, 0);
+			break;
+
+			//reset the connections nobody accepted, forget the half-open ones
+			case LISTEN:
+				while((i = esix_sockets[socknum].accept_head) >= 0)
+				{
+					esix_sockets[socknum].accept_head = esix_sockets[i].accept_next;
+					esix_sockets[i].flags &= ~SOCK_QUEUED;
+					if(esix_sockets[i].state != CLOSED)
+					{
+						esix_tcp_send_segment(i, esix_sockets[i].seqn, RST|ACK, NULL, 0);
+						esix_socket_release(i);
+					}
+				}
+				esix_sockets[socknum].accept_len = 0;
+
+				for(i=0; i<ESIX_MAX_SYN; i++)
+					if(esix_syn_table[i].listener == socknum)
+						esix_syn_table[i].rexmit_date = 0;
 			break;
 			default :
 			break;
 		}	
 	}
 	//uart_printf("close : closing %x\n", socknum);
-	esix_sockets[socknum].state = CLOSING;
-	esix_socket_free_queue(socknum);
-	esix_sockets[socknum].state = CLOSED;
+	esix_socket_release(socknum);
 
 	return 0;
 }
@@ -490,6 +1234,7 @@ int close(const int socknum)
 void esix_socket_free_queue(int socknum)
 {
 	struct sock_queue *sqe;
+	struct esix_sref *sref;
 
 	//purge the socket element list, one by one
 	while(esix_sockets[socknum].queue != NULL)
@@ -498,48 +1243,76 @@ void esix_socket_free_queue(int socknum)
 		sqe = esix_sockets[socknum].queue;
 		//remove the current element
 		esix_sockets[socknum].queue = sqe->next_e;
-		//free its payload, if any
-		if(sqe->qe_type == RECV_PKT || sqe->qe_type == SENT_PKT)
-			esix_w_free(sqe->data);
+		//free its payload
+		esix_socket_dgram_put(sqe->data);
 		//finally free it.
 		esix_w_free(sqe);
 	}
+	esix_sockets[socknum].rcv_queued = 0;
+
+	//and the tcp rings
+	if(esix_sockets[socknum].snd_ring.buf != NULL)
+		esix_w_free(esix_sockets[socknum].snd_ring.buf);
+	if(esix_sockets[socknum].rcv_ring.buf != NULL)
+		esix_w_free(esix_sockets[socknum].rcv_ring.buf);
+	esix_socket_clear_rings(socknum);
+
+	//the caller can have its send_ref() buffers back
+	while((sref = esix_sockets[socknum].sref) != NULL)
+	{
+		esix_sockets[socknum].sref = sref->next;
+		if(sref->done != NULL)
+			sref->done(socknum, sref->arg, -1);
+		esix_w_free(sref);
+	}
+	esix_sockets[socknum].sref_len = 0;
 }
 
 int send(const int socknum, const void *buf, const int len, const u8_t flags)
 {
+	int n, queued = 0;
+	u32_t start = esix_get_time_ms();
+
 	//send can be used with both TCP or UDP sockets but in case of
-	//UDP we need to make sure we're in connected state
-	if(esix_sockets[socknum].state != ESTABLISHED)
+	//UDP we need to make sure we're in connected state.
+	//TCP can still send once the peer closed its side.
+	if(esix_sockets[socknum].state != ESTABLISHED &&
+		!(esix_sockets[socknum].proto == SOCK_STREAM && esix_sockets[socknum].state == CLOSE_WAIT))
 		return -1;
 
 	if(esix_sockets[socknum].proto == SOCK_STREAM)
 	{
-		//queue the segment first, 
-		//if it fails, bail out and tell the user.
-		if(esix_queue_data(socknum, buf, len, NULL, OUT) < 0)
-			return 0;
-
-		//now that we made sure we saved it, try to send it.
-		//we can always retransmit it if needed.
-		esix_tcp_send(&esix_sockets[socknum].laddr, 
-					&esix_sockets[socknum].raddr,
-					esix_sockets[socknum].lport,
-					esix_sockets[socknum].rport,
-					esix_sockets[socknum].seqn,
-					esix_sockets[socknum].ackn,
-					PSH|ACK, buf, len);
+		//queue the data first, as much as the ring takes.
+		//if it's full, wait for the peer to acknowledge some, or
+		//bail out and tell the user.
+		while(1)
+		{
+			if((n = esix_ring_write(&esix_sockets[socknum].snd_ring,
+				(const u8_t *) buf + queued, len - queued)) > 0)
+			{
+				queued += n;
+				//now that we made sure we saved it, send what we're allowed to.
+				//we can always retransmit it if needed.
+				esix_tcp_output(socknum, 0);
+			}
 
-		esix_sockets[socknum].seqn+= len;
-		esix_sockets[socknum].rexmit_date = esix_get_time() + 2;
+			if(queued == len || (flags & MSG_DONTWAIT) ||
+				esix_socket_wait(socknum, esix_sockets[socknum].snd_timeo, start) < 0 ||
+				(esix_sockets[socknum].state != ESTABLISHED &&
+				esix_sockets[socknum].state != CLOSE_WAIT))
+				break;
+		}
 
-		return len;
+		esix_socket_ready(socknum);
+		return queued;
 	}
 	else if(esix_sockets[socknum].proto == SOCK_DGRAM)
 	{
+		if(len > esix_sockets[socknum].snd_size)
+			return -1;
+
 		//not saving sent UDP packets
-		esix_udp_send(&esix_sockets[socknum].laddr,
-					&esix_sockets[socknum].raddr,
+		esix_udp_send_tmpl(&esix_sockets[socknum].tmpl,
 					esix_sockets[socknum].lport,
 					esix_sockets[socknum].rport,
 					buf, len);
@@ -550,104 +1323,953 @@ int send(const int socknum, const void *buf, const int len, const u8_t flags)
 		return -1;
 }
 
-int esix_port_available(const u16_t port)
+int send_ref(const int socknum, const void *buf, const int len,
+	void (*done)(int, void *, int), void *arg)
 {
-	int i=0;
-	while(i<ESIX_MAX_SOCK)
-	{
-		if(esix_sockets[i].state != CLOSED &&
-			esix_sockets[i].lport == port)
-			return -1;
-		i++;
-	}
-	return 0;
+	struct esix_sref *sref, **last;
+
+	if(esix_sockets[socknum].proto != SOCK_STREAM || len <= 0 ||
+		(esix_sockets[socknum].state != ESTABLISHED &&
+		esix_sockets[socknum].state != CLOSE_WAIT))
+		return -1;
+
+	if((sref = esix_w_malloc(sizeof(struct esix_sref))) == NULL)
+		return -1;
+
+	//the buffer takes its place at the end of the stream,
+	//segments are built right out of it.
+	sref->data	= buf;
+	sref->seqn	= esix_sockets[socknum].snd_una + esix_socket_snd_len(socknum);
+	sref->len	= len;
+	sref->done	= done;
+	sref->arg	= arg;
+	sref->next	= NULL;
+
+	for(last = &esix_sockets[socknum].sref; *last != NULL; last = &(*last)->next)
+		;
+	*last = sref;
+	esix_sockets[socknum].sref_len += len;
+
+	esix_tcp_output(socknum, 0);
+
+	return len;
 }
 
-//expires every sent packet with (seq number + payload_len) < ackn
-int esix_socket_expire_e(int s, u32_t ackn)
+int poll(struct pollfd *fds, int nfds, int timeout)
 {
-	int i=0;
-	struct sock_queue *sqe, *prev_sqe, *tmp;
-	sqe = prev_sqe = esix_sockets[s].queue;
+	int i, s, n;
+	u32_t start = esix_get_time_ms();
 
-	//find the first available eligible packet in queue
-	//and keep a reference to the previous queue element
-	while(sqe != NULL)
+	//counted before looking, so that nothing happening in between is missed
+	esix_pollers++;
+	while(1)
 	{
-		if(sqe->qe_type == SENT_PKT)
+		for(i = n = 0; i < nfds; i++)
 		{
-			if(sqe->seqn + sqe->data_len <= ackn)
+			s = fds[i].fd;
+			fds[i].revents = 0;
+
+			if(s < 0)
+				continue;
+			if(s >= ESIX_MAX_SOCK)
+				fds[i].revents = POLLNVAL;
+			//edge-triggered : what came up since the last time, reported once
+			else if(fds[i].events & POLLET)
 			{
-				tmp = sqe;
-				//first element needs special treatment
-				if(esix_sockets[s].queue == sqe)
-					esix_sockets[s].queue = sqe->next_e;
-				else
-					prev_sqe->next_e = sqe->next_e;
-		
-				//update pointer to move forward
-					sqe 	= sqe->next_e;
-
-				//free the element and its data
-				esix_w_free(tmp->data);
-				esix_w_free(tmp);
-	
-				i++;
+				fds[i].revents = esix_sockets[s].ready_edge & (fds[i].events | POLLERR | POLLHUP);
+				esix_sockets[s].ready_edge &= ~fds[i].revents;
 			}
-			else 
-				break; //we're done here.
-		}
-		else
-		{
-			prev_sqe= sqe; 
-			sqe 	= sqe->next_e;
+			else
+				fds[i].revents = esix_sockets[s].ready & (fds[i].events | POLLERR | POLLHUP);
+
+			if(fds[i].revents)
+				n++;
 		}
+
+		if(n > 0 || timeout == 0 ||
+			esix_socket_wait(ESIX_MAX_SOCK, timeout < 0 ? 0 : timeout, start) < 0)
+			break;
 	}
+	esix_pollers--;
 
-	return i;
+	return n;
 }
-	
-//in charge of retransmission / time outs
-void esix_socket_housekeep()
+
+int set_callbacks(int socknum, const struct sock_callbacks *cb, void *arg)
 {
-	int s;
-	struct sock_queue *sqe;
-	for(s=0; s<ESIX_MAX_SOCK; s++)
-	{
-		//either retransmission is disabled or scheduled for
-		//a later time on this socket
-		if(esix_sockets[s].rexmit_date == 0 ||
-			esix_sockets[s].rexmit_date > esix_get_time())
-			continue;
+	if(socknum < 0 || socknum >= ESIX_MAX_SOCK || esix_sockets[socknum].state == CLOSED)
+		return -1;
 
-		//show time. find the first available packet and resend it.
-		if((sqe = esix_socket_find_e(s, SENT_PKT, KEEP)) != NULL) 
-		{
-			if(esix_get_time() - sqe->t_sent > MAX_RETX_TIME)
+	esix_sockets[socknum].cb = cb;
+	esix_sockets[socknum].cb_arg = arg;
+	return 0;
+}
+
+//raw API : hands a received datagram (or the end of a stream, data NULL)
+//over to the socket's on_recv callback. returns -1 if it has none.
+int esix_socket_raw_recv(int s, const void *data, int len, const struct sockaddr_in6 *from)
+{
+	if(esix_sockets[s].cb == NULL || esix_sockets[s].cb->on_recv == NULL)
+		return -1;
+
+	esix_sockets[s].cb->on_recv(s, data, len, from, esix_sockets[s].cb_arg);
+	return len;
+}
+
+//raw API : a connection was established on a listening socket, hand it
+//over to its on_accept callback if it has one. it's taken off the accept
+//queue first.
+void esix_socket_raw_accept(int listener, int s)
+{
+	if(esix_sockets[listener].cb == NULL || esix_sockets[listener].cb->on_accept == NULL)
+		return;
+
+	if((s = accept(listener, NULL, NULL)) >= 0)
+		esix_sockets[listener].cb->on_accept(listener, s, esix_sockets[listener].cb_arg);
+}
+
+//the connection was refused, reset or timed out : release the socket and
+//let the raw API know
+void esix_socket_lost(int s)
+{
+	const struct sock_callbacks *cb = esix_sockets[s].cb;
+	void *arg = esix_sockets[s].cb_arg;
+
+	esix_socket_release(s);
+	if(cb != NULL && cb->on_error != NULL)
+		cb->on_error(s, arg);
+}
+
+int setsockopt(int socknum, int level, int option, const void *value, int len)
+{
+	int val;
+	const struct ipv6_mreq *mreq;
+
+	if(esix_sockets[socknum].state == CLOSED || value == NULL || len < sizeof(int))
+		return -1;
+
+	val = *((const int *) value);
+
+	switch(level)
+	{
+		case SOL_SOCKET:
+			switch(option)
 			{
-				//we've been trying far too long
-				esix_tcp_send(&esix_sockets[s].laddr, 
-						&esix_sockets[s].raddr, esix_sockets[s].lport,
-						esix_sockets[s].rport, esix_sockets[s].seqn,
-						esix_sockets[s].ackn, RST|ACK, NULL, 0);
-				esix_sockets[s].state = CLOSING;
-				esix_socket_free_queue(s);
-				esix_sockets[s].state = CLOSED;
-				uart_printf("esix_socket_housekeep : socket %x timed out, closing.\n", s);
-				continue;
-			} 
+				case SO_RCVTIMEO:
+					if(val < 0)
+						return -1;
+					esix_sockets[socknum].rcv_timeo = val;
+				break;
 
-			//first update the retransmission date
-			//exp backoff fashion
-			esix_sockets[s].rexmit_date = esix_get_time() + 
-				((esix_get_time() - sqe->t_sent)^2);
+				case SO_SNDTIMEO:
+					if(val < 0)
+						return -1;
+					esix_sockets[socknum].snd_timeo = val;
+				break;
+
+				case SO_REUSEADDR:
+					if(val)
+						esix_sockets[socknum].flags |= SOCK_REUSEADDR;
+					else
+						esix_sockets[socknum].flags &= ~SOCK_REUSEADDR;
+				break;
+
+				case SO_SNDBUF:
+				case SO_RCVBUF:
+					//a tcp connection's rings are already there
+					if(val < 1 || val > 0xffff || (esix_sockets[socknum].proto == SOCK_STREAM &&
+						esix_sockets[socknum].snd_ring.buf != NULL))
+						return -1;
+
+					if(option == SO_SNDBUF)
+						esix_sockets[socknum].snd_size = val;
+					else
+						esix_sockets[socknum].rcv_size = val;
+				break;
+
+				case SO_KEEPALIVE:
+					if(esix_sockets[socknum].proto != SOCK_STREAM)
+						return -1;
 
-			esix_tcp_send(&esix_sockets[s].laddr, 
-				&esix_sockets[s].raddr, esix_sockets[s].lport,
-				esix_sockets[s].rport,	sqe->seqn,
-				esix_sockets[s].ackn,	PSH|ACK, 
-				sqe->data, sqe->data_len);
+					if(val)
+						esix_sockets[socknum].flags |= SOCK_KEEPALIVE;
+					else
+						esix_sockets[socknum].flags &= ~SOCK_KEEPALIVE;
+					esix_socket_keepalive(socknum);
+				break;
+
+				default:
+					return -1;
+			}
+		break;
 
+		case IPPROTO_TCP:
+			if(esix_sockets[socknum].proto != SOCK_STREAM)
+				return -1;
+
+			switch(option)
+			{
+				case TCP_KEEPIDLE:
+					if(val < 1 || val > 0xffff)
+						return -1;
+					esix_sockets[socknum].keep_idle = val;
+					esix_socket_keepalive(socknum);
+				break;
+
+				case TCP_KEEPINTVL:
+					if(val < 1 || val > 0xffff)
+						return -1;
+					esix_sockets[socknum].keep_intvl = val;
+				break;
+
+				case TCP_KEEPCNT:
+					if(val < 1 || val > 0xff)
+						return -1;
+					esix_sockets[socknum].keep_cnt = val;
+				break;
+
+				case TCP_IDLE_TIMEOUT:
+					if(val < 0)
+						return -1;
+					esix_sockets[socknum].idle_timeout = val;
+					esix_socket_keepalive(socknum);
+				break;
+
+				case TCP_NODELAY:
+					if(val)
+					{
+						esix_sockets[socknum].flags |= SOCK_NODELAY;
+						esix_tcp_output(socknum, 0);
+					}
+					else
+						esix_sockets[socknum].flags &= ~SOCK_NODELAY;
+				break;
+
+				case TCP_CORK:
+					if(val)
+						esix_sockets[socknum].flags |= SOCK_CORK;
+					else
+					{
+						//flush what was corked
+						esix_sockets[socknum].flags &= ~SOCK_CORK;
+						esix_tcp_output(socknum, 1);
+					}
+				break;
+
+				default:
+					return -1;
+			}
+		break;
+
+		case IPPROTO_IPV6:
+			if(esix_sockets[socknum].proto != SOCK_DGRAM || len < sizeof(struct ipv6_mreq))
+				return -1;
+
+			mreq = value;
+			//only multicast groups can be joined
+			if(mreq->ipv6mr_multiaddr.u6_addr8[0] != 0xff)
+				return -1;
+
+			switch(option)
+			{
+				case IPV6_JOIN_GROUP:
+					return esix_socket_join(socknum, (struct ip6_addr *) &mreq->ipv6mr_multiaddr);
+
+				case IPV6_LEAVE_GROUP:
+					return esix_socket_leave(socknum, (struct ip6_addr *) &mreq->ipv6mr_multiaddr);
+
+				default:
+					return -1;
+			}
+		break;
+
+		default:
+			return -1;
+	}
+
+	return 0;
+}
+
+int getsockopt(int socknum, int level, int option, void *value, int *len)
+{
+	int val;
+
+	if(esix_sockets[socknum].state == CLOSED || value == NULL ||
+		len == NULL || *len < sizeof(int))
+		return -1;
+
+	switch(level)
+	{
+		case SOL_SOCKET:
+			switch(option)
+			{
+				case SO_KEEPALIVE:
+					val = (esix_sockets[socknum].flags & SOCK_KEEPALIVE) != 0;
+				break;
+
+				case SO_REUSEADDR:
+					val = (esix_sockets[socknum].flags & SOCK_REUSEADDR) != 0;
+				break;
+
+				case SO_RCVTIMEO:
+					val = esix_sockets[socknum].rcv_timeo;
+				break;
+
+				case SO_SNDTIMEO:
+					val = esix_sockets[socknum].snd_timeo;
+				break;
+
+				case SO_SNDBUF:
+					val = esix_sockets[socknum].snd_size;
+				break;
+
+				case SO_RCVBUF:
+					val = esix_sockets[socknum].rcv_size;
+				break;
+
+				case SO_RCVDROPS:
+					val = esix_sockets[socknum].rcv_drops;
+				break;
+
+				default:
+					return -1;
+			}
+		break;
+
+		case IPPROTO_TCP:
+			if(esix_sockets[socknum].proto != SOCK_STREAM)
+				return -1;
+
+			switch(option)
+			{
+				case TCP_KEEPIDLE:
+					val = esix_sockets[socknum].keep_idle;
+				break;
+
+				case TCP_KEEPINTVL:
+					val = esix_sockets[socknum].keep_intvl;
+				break;
+
+				case TCP_KEEPCNT:
+					val = esix_sockets[socknum].keep_cnt;
+				break;
+
+				case TCP_IDLE_TIMEOUT:
+					val = esix_sockets[socknum].idle_timeout;
+				break;
+
+				case TCP_NODELAY:
+					val = (esix_sockets[socknum].flags & SOCK_NODELAY) != 0;
+				break;
+
+				case TCP_CORK:
+					val = (esix_sockets[socknum].flags & SOCK_CORK) != 0;
+				break;
+
+				default:
+					return -1;
+			}
+		break;
+
+		default:
+			return -1;
+	}
+
+	*((int *) value) = val;
+	*len = sizeof(int);
+	return 0;
+}
+
+//returns -1 if a socket of that protocol holds the local port (network byte order)
+int esix_port_available(u16_t port, u8_t proto)
+{
+	int i, bucket = esix_socket_port_bucket(port, proto);
+
+	for(i = esix_port_hash[bucket]; i >= 0; i = esix_sockets[i].port_next)
+		if(esix_sockets[i].proto == proto && esix_sockets[i].lport == port)
+			return -1;
+
+	//don't reuse the port of a connection in TIME_WAIT either
+	if(proto == SOCK_STREAM)
+		for(i = esix_tw_port_hash[bucket]; i >= 0; i = esix_tw_table[i].port_next)
+			if(esix_tw_table[i].lport == port)
+				return -1;
+	return 0;
+}
+
+//frees a TIME_WAIT entry
+void esix_socket_tw_free(int tw)
+{
+	int *cur;
+
+	if(esix_tw_table[tw].expiration_date == 0)
+		return;
+
+	cur = &esix_tw_port_hash[esix_socket_port_bucket(esix_tw_table[tw].lport, SOCK_STREAM)];
+	while(*cur >= 0 && *cur != tw)
+		cur = &esix_tw_table[*cur].port_next;
+	if(*cur == tw)
+		*cur = esix_tw_table[tw].port_next;
+
+	esix_tw_table[tw].expiration_date = 0;
+}
+
+//moves a tcp connection to the TIME_WAIT table for 2 MSL and releases its
+//socket. if the table is full, the entry closest to expiration makes room.
+void esix_socket_time_wait(int s)
+{
+	int i, tw = 0;
+
+	for(i=0; i<ESIX_MAX_TW; i++)
+	{
+		if(esix_tw_table[i].expiration_date == 0)
+		{
+			tw = i;
+			break;
+		}
+		if(esix_tw_table[i].expiration_date < esix_tw_table[tw].expiration_date)
+			tw = i;
+	}
+
+	esix_socket_tw_free(tw);
+	esix_memcpy(&esix_tw_table[tw].laddr, &esix_sockets[s].laddr, 16);
+	esix_memcpy(&esix_tw_table[tw].raddr, &esix_sockets[s].raddr, 16);
+	esix_tw_table[tw].lport = esix_sockets[s].lport;
+	esix_tw_table[tw].rport = esix_sockets[s].rport;
+	esix_tw_table[tw].seqn	= esix_sockets[s].seqn;
+	esix_tw_table[tw].ackn	= esix_sockets[s].ackn;
+	esix_tw_table[tw].expiration_date = esix_get_time() + 2*ESIX_MSL;
+
+	i = esix_socket_port_bucket(esix_tw_table[tw].lport, SOCK_STREAM);
+	esix_tw_table[tw].port_next = esix_tw_port_hash[i];
+	esix_tw_port_hash[i] = tw;
+
+	esix_socket_release(s);
+}
+
+//returns the TIME_WAIT entry of a connection, or -1
+int esix_socket_find_tw(const struct ip6_addr *saddr, const struct ip6_addr *daddr, u16_t sport, u16_t dport)
+{
+	int i;
+
+	for(i=0; i<ESIX_MAX_TW; i++)
+		if(esix_tw_table[i].expiration_date != 0 &&
+			esix_tw_table[i].lport == dport &&
+			esix_tw_table[i].rport == sport &&
+			esix_memcmp(&esix_tw_table[i].raddr, saddr, 16) == 0 &&
+			esix_memcmp(&esix_tw_table[i].laddr, daddr, 16) == 0)
+			return i;
+
+	return -1;
+}
+
+//bytes of the send stream from snd_una on, sent or not
+u32_t esix_socket_snd_len(int s)
+{
+	return esix_sockets[s].snd_ring.len + esix_sockets[s].sref_len;
+}
+
+//bytes of data sent and not acknowledged yet, the SYN and FIN left out
+int esix_socket_flight(int s)
+{
+	u32_t flight = esix_sockets[s].seqn - esix_sockets[s].snd_una;
+
+	if(flight > esix_socket_snd_len(s))
+		flight = esix_socket_snd_len(s);
+	return flight;
+}
+
+//copies len bytes of the send stream starting at seqn : out of the
+//send_ref() buffers, the rest out of the send ring
+void esix_socket_snd_get(int s, u32_t seqn, void *buf, int len)
+{
+	struct esix_sref *sref;
+	u32_t off = seqn - esix_sockets[s].snd_una, end;
+	int n;
+
+	//the ring only holds what's not referenced
+	for(sref = esix_sockets[s].sref; sref != NULL && SEQ_LT(sref->seqn, seqn); sref = sref->next)
+	{
+		end = sref->seqn + sref->len;
+		off -= (SEQ_LT(end, seqn) ? end : seqn) - sref->seqn;
+	}
+
+	for(sref = esix_sockets[s].sref; len > 0; )
+	{
+		while(sref != NULL && SEQ_LEQ(sref->seqn + sref->len, seqn))
+			sref = sref->next;
+
+		if(sref != NULL && SEQ_LEQ(sref->seqn, seqn))
+		{
+			n = sref->seqn + sref->len - seqn;
+			if(n > len)
+				n = len;
+			esix_memcpy(buf, sref->data + (seqn - sref->seqn), n);
+		}
+		else
+		{
+			n = len;
+			if(sref != NULL && (int) (sref->seqn - seqn) < n)
+				n = sref->seqn - seqn;
+			esix_ring_get(&esix_sockets[s].snd_ring, off, buf, n);
+			off += n;
+		}
+
+		buf = (u8_t *) buf + n;
+		seqn += n;
+		len -= n;
+	}
+}
+
+//inserts [left, right[ in a sorted list of disjoint, non-adjacent intervals,
+//merging it with every interval it overlaps or touches. returns -1 if
+//that takes more than ESIX_OOO_DEPHT intervals.
+static int esix_socket_add_block(struct esix_block *blocks, u8_t *n, u32_t left, u32_t right)
+{
+	int i, j, first = *n, last = -1;
+
+	//the intervals it touches, then the ones it goes between
+	for(i = 0; i < *n; i++)
+	{
+		if(SEQ_GT(blocks[i].left, right))
+			break;
+		if(SEQ_LT(blocks[i].right, left))
+			continue;
+
+		if(i < first)
+			first = i;
+		last = i;
+	}
+
+	if(last < 0)
+	{
+		if(*n >= ESIX_OOO_DEPHT)
+			return -1;
+
+		for(j = *n; j > i; j--)
+			blocks[j] = blocks[j-1];
+		blocks[i].left	= left;
+		blocks[i].right	= right;
+		(*n)++;
+		return 0;
+	}
+
+	if(SEQ_LT(blocks[first].left, left))
+		left = blocks[first].left;
+	if(SEQ_GT(blocks[last].right, right))
+		right = blocks[last].right;
+
+	blocks[first].left	= left;
+	blocks[first].right	= right;
+	for(i = first + 1, j = last + 1; j < *n; i++, j++)
+		blocks[i] = blocks[j];
+	*n -= last - first;
+
+	return 0;
+}
+
+//forgets everything below seqn in a list of intervals
+static void esix_socket_trim_blocks(struct esix_block *blocks, u8_t *n, u32_t seqn)
+{
+	int i, j = 0;
+
+	for(i = 0; i < *n; i++)
+	{
+		if(SEQ_LEQ(blocks[i].right, seqn))
+			continue;
+		blocks[j] = blocks[i];
+		if(SEQ_LT(blocks[j].left, seqn))
+			blocks[j].left = seqn;
+		j++;
+	}
+	*n = j;
+}
+
+//releases what ackn acknowledges from the send ring and the send_ref() buffers.
+//returns the number of bytes acknowledged.
+int esix_socket_expire(int s, u32_t ackn)
+{
+	u32_t acked, seqn = esix_sockets[s].snd_una, end, unacked = esix_socket_snd_len(s);
+	int ring = 0, n;
+	struct esix_sref *sref;
+
+	if(SEQ_LEQ(ackn, esix_sockets[s].snd_una))
+		return 0;
+
+	acked = ackn - esix_sockets[s].snd_una;
+	end = seqn + esix_socket_snd_len(s);
+	if(SEQ_LT(ackn, end))
+		end = ackn;
+
+	//the referenced buffers are done with once all of them is acknowledged,
+	//what's between them comes out of the ring
+	while((sref = esix_sockets[s].sref) != NULL && SEQ_LT(sref->seqn, end))
+	{
+		ring += sref->seqn - seqn;
+		n = sref->len;
+		if(SEQ_LT(end, sref->seqn + n))
+			n = end - sref->seqn;
+
+		sref->data	+= n;
+		sref->seqn	+= n;
+		sref->len	-= n;
+		esix_sockets[s].sref_len -= n;
+		seqn = sref->seqn;
+
+		if(sref->len > 0)
+			break;
+
+		esix_sockets[s].sref = sref->next;
+		if(sref->done != NULL)
+			sref->done(s, sref->arg, 0);
+		esix_w_free(sref);
+	}
+	if(SEQ_LT(seqn, end))
+		ring += end - seqn;
+
+	esix_ring_drop(&esix_sockets[s].snd_ring, ring);
+	esix_sockets[s].snd_una = ackn;
+	esix_sockets[s].rtx_len = 0;
+	esix_sockets[s].rexmits = 0;
+	esix_socket_wake(s);
+	esix_socket_trim_blocks(esix_sockets[s].sack, &esix_sockets[s].sack_n, ackn);
+
+	//what's still in flight is timed from now on
+	esix_sockets[s].snd_date = esix_get_time();
+
+	//data only, without our SYN or FIN
+	if(esix_sockets[s].cb != NULL && esix_sockets[s].cb->on_sent != NULL &&
+		unacked > esix_socket_snd_len(s))
+		esix_sockets[s].cb->on_sent(s, unacked - esix_socket_snd_len(s), esix_sockets[s].cb_arg);
+
+	return acked;
+}
+
+//stores an out-of-order TCP segment in the receive ring, where it will
+//be once the gap in front of it is filled, and records its interval.
+int esix_socket_queue_ooo(int s, const void *data, int len, u32_t seqn)
+{
+	struct esix_sock *sock = &esix_sockets[s];
+	u32_t off = seqn - sock->ackn;
+
+	//it has to fit in the ring, past what's waiting to be read
+	if(sock->rcv_ring.len + off + len > sock->rcv_ring.size)
+		return -1;
+
+	//too many holes already
+	if(esix_socket_add_block(sock->ooo, &sock->ooo_n, seqn, seqn + len) < 0)
+		return -1;
+
+	esix_ring_put(&sock->rcv_ring, sock->rcv_ring.len + off, data, len);
+
+	return len;
+}
+
+//queues in-order TCP data, as much as the receive ring takes. if it fills
+//the gap in front of the first out-of-order interval, that one is already
+//in place. returns the number of bytes the receive sequence moved forward.
+int esix_socket_queue_stream(int s, const void *data, int len)
+{
+	struct esix_sock *sock = &esix_sockets[s];
+	int n, extra = 0;
+
+	//raw API : with nothing buffered, hand it over right out of the segment
+	if(sock->cb != NULL && sock->cb->on_recv != NULL &&
+		sock->rcv_ring.len == 0 && sock->ooo_n == 0)
+	{
+		sock->ackn += len;
+		sock->cb->on_recv(s, data, len, NULL, sock->cb_arg);
+		return len;
+	}
+
+	if((n = esix_ring_write(&sock->rcv_ring, data, len)) == 0)
+		return -1;
+	sock->ackn += n;
+
+	//intervals are disjoint, at most the first one can be reached
+	if(sock->ooo_n > 0 && SEQ_LEQ(sock->ooo[0].left, sock->ackn))
+	{
+		if(SEQ_GT(sock->ooo[0].right, sock->ackn))
+			extra = sock->ooo[0].right - sock->ackn;
+		sock->rcv_ring.len += extra;
+		sock->ackn += extra;
+	}
+	esix_socket_trim_blocks(sock->ooo, &sock->ooo_n, sock->ackn);
+
+	//raw API : hand over what's contiguous now, in at most two pieces as
+	//the ring wraps. it's dropped first, that doesn't overwrite it.
+	while(sock->cb != NULL && sock->cb->on_recv != NULL && sock->rcv_ring.len > 0)
+	{
+		data = sock->rcv_ring.buf + sock->rcv_ring.head;
+		if((len = sock->rcv_ring.size - sock->rcv_ring.head) > sock->rcv_ring.len)
+			len = sock->rcv_ring.len;
+		esix_ring_drop(&sock->rcv_ring, len);
+		sock->cb->on_recv(s, data, len, NULL, sock->cb_arg);
+	}
+	esix_socket_wake(s);
+
+	return n + extra;
+}
+
+//SACK scoreboard : records the [left, right[ block, clipped to what's in flight
+int esix_socket_sack(int s, u32_t left, u32_t right)
+{
+	u32_t una = esix_sockets[s].snd_una;
+	u32_t end = una + esix_socket_flight(s);
+
+	if(SEQ_LT(left, una))
+		left = una;
+	if(SEQ_GT(right, end))
+		right = end;
+	if(SEQ_GEQ(left, right))
+		return 0;
+
+	return esix_socket_add_block(esix_sockets[s].sack, &esix_sockets[s].sack_n, left, right) == 0;
+}
+
+//resends [seqn, end[ out of the send ring, MSS by MSS
+static void esix_socket_rexmit(int s, u32_t seqn, u32_t end)
+{
+	int n;
+
+	while(SEQ_LT(seqn, end))
+	{
+		n = end - seqn;
+		if(n > esix_tcp_seg_size(s))
+			n = esix_tcp_seg_size(s);
+
+		esix_tcp_send_segment(s, seqn, PSH|ACK, NULL, n);
+		seqn += n;
+	}
+}
+
+//tells whether a hole is deemed lost (RFC 6675) : TCP_DUPTHRESH SACKed
+//blocks above it, or more than TCP_DUPTHRESH - 1 segments worth of SACKed data.
+static int esix_socket_hole_lost(int s, int blocks, int sacked)
+{
+	return blocks >= TCP_DUPTHRESH ||
+		sacked > (TCP_DUPTHRESH - 1) * esix_sockets[s].mss;
+}
+
+//resends the holes of the SACK scoreboard. a lost hole is resent once.
+//on timeout, the first segment and every hole below a SACKed block
+//are resent, whether they've already been or not.
+void esix_socket_rexmit_holes(int s, int on_timeout)
+{
+	int i, sacked = 0, blocks = esix_sockets[s].sack_n, reduced = 0;
+	u32_t seqn = esix_sockets[s].snd_una, start;
+	struct esix_block *sack = esix_sockets[s].sack;
+
+	for(i = 0; i < blocks; i++)
+		sacked += sack[i].right - sack[i].left;
+
+	if(!on_timeout && !esix_socket_hole_lost(s, blocks, sacked))
+		return;
+
+	//a hole ends where a SACKed block starts
+	for(i = 0; i < esix_sockets[s].sack_n; i++)
+	{
+		start = seqn;
+		if(!on_timeout && SEQ_LT(start, esix_sockets[s].rexmit_high))
+			start = esix_sockets[s].rexmit_high;
+
+		if((on_timeout || esix_socket_hole_lost(s, blocks, sacked)) &&
+			SEQ_LT(start, sack[i].left))
+		{
+			//a new loss, slow down
+			if(!on_timeout && !reduced)
+			{
+				esix_tcp_congestion(s, 0);
+				reduced = 1;
+			}
+			esix_socket_rexmit(s, start, sack[i].left);
+			if(SEQ_GT(sack[i].left, esix_sockets[s].rexmit_high))
+				esix_sockets[s].rexmit_high = sack[i].left;
+		}
+
+		//the peer already has this one, there's less SACKed data above the next holes
+		sacked -= sack[i].right - sack[i].left;
+		blocks--;
+		seqn = sack[i].right;
+	}
+
+	//nothing SACKed : resend the first segment
+	if(on_timeout && esix_sockets[s].sack_n == 0)
+	{
+		i = esix_socket_flight(s);
+		if(i > esix_tcp_seg_size(s))
+			i = esix_tcp_seg_size(s);
+		esix_socket_rexmit(s, seqn, seqn + i);
+	}
+}
+
+//we've been trying far too long : reset the connection
+static void esix_socket_abort(int s)
+{
+	esix_tcp_send(&esix_sockets[s].laddr, 
+			&esix_sockets[s].raddr, esix_sockets[s].lport,
+			esix_sockets[s].rport, esix_sockets[s].seqn,
+			esix_sockets[s].ackn, RST|ACK, NULL, 0);
+	esix_socket_lost(s);
+	uart_printf("esix_socket_housekeep : socket %x timed out, closing.\n", s);
+}
+
+//the retransmission timer doubles with each timeout in a row (RFC 6298 5.5),
+//starting from 2s
+static void esix_socket_backoff(int s)
+{
+	if(esix_sockets[s].rexmits < TCP_MAX_BACKOFF)
+		esix_sockets[s].rexmits++;
+
+	esix_sockets[s].rexmit_date = esix_get_time() + (2 << esix_sockets[s].rexmits);
+}
+
+/*
+ * Keepalive and idle timeout timer. Segments coming in only update rcv_date :
+ * the timer goes off at the first deadline counted from it, then probes,
+ * aborts or is pushed back to the next deadline.
+ * Also (re)arms the timer when the connection or its options change.
+ */
+void esix_socket_keepalive(int s)
+{
+	u32_t idle, next = 0, delay;
+
+	esix_timer_stop(&esix_sockets[s].keep_timer);
+	if(esix_sockets[s].state != ESTABLISHED && esix_sockets[s].state != CLOSE_WAIT)
+		return;
+
+	idle = esix_get_time() - esix_sockets[s].rcv_date;
+
+	if(esix_sockets[s].idle_timeout != 0)
+	{
+		if(idle >= esix_sockets[s].idle_timeout)
+		{
+			esix_socket_abort(s);
+			return;
+		}
+		next = esix_sockets[s].idle_timeout - idle;
+	}
+
+	if(esix_sockets[s].flags & SOCK_KEEPALIVE)
+	{
+		//the peer was heard of lately, or it has data to acknowledge :
+		//retransmissions already tell whether it's gone
+		if(idle < esix_sockets[s].keep_idle)
+		{
+			esix_sockets[s].keep_probes = 0;
+			delay = esix_sockets[s].keep_idle - idle;
+		}
+		else if(esix_socket_snd_len(s) > 0)
+			delay = esix_sockets[s].keep_intvl;
+		else if(esix_sockets[s].keep_probes >= esix_sockets[s].keep_cnt)
+		{
+			esix_socket_abort(s);
+			return;
+		}
+		else
+		{
+			//an old sequence number, the peer has to ACK it
+			esix_sockets[s].keep_probes++;
+			esix_tcp_send_segment(s, esix_sockets[s].seqn - 1, ACK, NULL, 0);
+			delay = esix_sockets[s].keep_intvl;
+		}
+
+		if(next == 0 || delay < next)
+			next = delay;
+	}
+
+	if(next == 0)
+		return;
+
+	//it's looked at again then, anyway
+	if(next > 0xffff)
+		next = 0xffff;
+	esix_timer_start(&esix_sockets[s].keep_timer, next * 1000);
+}
+
+//in charge of retransmission / time outs
+void esix_socket_housekeep()
+{
+	int s;
+	u8_t ctl;
+
+	//2 MSL elapsed
+	for(s=0; s<ESIX_MAX_TW; s++)
+		if(esix_tw_table[s].expiration_date != 0 &&
+			esix_tw_table[s].expiration_date <= esix_get_time())
+			esix_socket_tw_free(s);
+
+	//resend the SYN|ACKs that weren't answered, then give up
+	for(s=0; s<ESIX_MAX_SYN; s++)
+	{
+		if(esix_syn_table[s].rexmit_date == 0 ||
+			esix_syn_table[s].rexmit_date > esix_get_time())
+			continue;
+
+		if(esix_syn_table[s].retries++ >= TCP_SYNACK_RETRIES)
+		{
+			esix_syn_table[s].rexmit_date = 0;
+			continue;
+		}
+
+		esix_syn_table[s].rexmit_date = esix_get_time() + (2 << esix_syn_table[s].retries);
+		esix_tcp_send_synack(s);
+	}
+
+	for(s=0; s<ESIX_MAX_SOCK; s++)
+	{
+		//either retransmission is disabled or scheduled for
+		//a later time on this socket
+		if(esix_sockets[s].rexmit_date == 0 ||
+			esix_sockets[s].rexmit_date > esix_get_time())
+			continue;
+
+		//the peer never closed its side
+		if(esix_sockets[s].state == FIN_WAIT_2)
+		{
+			esix_socket_release(s);
+			continue;
+		}
+
+		//show time. resend the oldest data in flight.
+		if(esix_socket_flight(s) > 0) 
+		{
+			if(esix_get_time() - esix_sockets[s].snd_date > MAX_RETX_TIME)
+			{
+				esix_socket_abort(s);
+				continue;
+			} 
+
+			//first update the retransmission date
+			//exp backoff fashion
+			esix_socket_backoff(s);
+
+			//back to slow start, then resend the first unSACKed
+			//segment and the holes
+			esix_tcp_congestion(s, 1);
+			esix_socket_rexmit_holes(s, 1);
+
+		}
+		else if((ctl = esix_tcp_ctl_unacked(s)) != 0)
+		{
+			//our SYN or FIN didn't make it
+			if(esix_get_time() - esix_sockets[s].ctl_date > MAX_RETX_TIME)
+			{
+				esix_socket_abort(s);
+				continue;
+			}
+
+			esix_socket_backoff(s);
+			esix_tcp_send_segment(s, esix_sockets[s].seqn - 1, ctl, NULL, 0);
+		}
+		else if(!(esix_sockets[s].flags & SOCK_FIN_SENT) &&
+			esix_socket_snd_len(s) > 0)
+		{
+			//nothing in flight but data is waiting : the peer closed its window.
+			//probe it with an old sequence number, the ACK it triggers
+			//tells us when the window opens again.
+			esix_sockets[s].rexmit_date = esix_get_time() + 2;
+			esix_tcp_send_segment(s, esix_sockets[s].seqn - 1, ACK, NULL, 0);
 		}
 		else
 		{
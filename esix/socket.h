@@ -4,6 +4,8 @@
 #include "esix.h"
 #include "include/socket.h"
 #include "ip6.h"
+#include "timer.h"
+#include "tools.h"
 
 enum state
 {
@@ -21,12 +23,6 @@ enum state
 	RESERVED //internal state
 };
 
-enum direction
-{
-	IN,
-	OUT
-};
-
 enum action
 {
 	KEEP,
@@ -36,23 +32,45 @@ enum action
 //queue element type
 enum qe_type
 {
-	CHILD_SOCK, //child socket, created upon SYN reception
-	SENT_PKT,
 	RECV_PKT
 };
 
+//what a queued udp datagram's payload comes right after
+struct esix_dgram
+{
+	void *buf; //buffer to free : the datagram copy, or the received packet
+	struct sockaddr_in6 from; //sender
+	u8_t refs; //queues it's in and recv_zc() loans, multicast ones are shared
+};
+
+//udp datagram queue
 struct sock_queue
 {
 	enum qe_type qe_type;
-	int socknum; 			//only used with CHILD_SOCK
 	struct sockaddr_in6 *sockaddr;  //only used by UDP for RX packets, addr&port of sender
-	u32_t seqn;			//stores the sequence number of this packet
-	void *data; //actual data
+	void *data; //actual data, udp : a struct esix_dgram and the payload
 	int data_len; //data length
-	u32_t t_sent; //time at which the packet was queued
 	struct sock_queue *next_e; //next queued element
 };
 
+//caller memory referenced by send_ref(), part of the send stream
+struct esix_sref
+{
+	const u8_t *data; //what's left of it to acknowledge
+	u32_t seqn; //sequence number of data
+	int len;
+	void (*done)(int, void *, int); //called once it's all acknowledged, or the connection is gone
+	void *arg;
+	struct esix_sref *next; //next reference, in sequence order
+};
+
+//[left, right[ sequence number interval
+struct esix_block
+{
+	u32_t left;
+	u32_t right;
+};
+
 //actual session sockets, holding seq/ack/etc info
 struct esix_sock
 {
@@ -62,10 +80,103 @@ struct esix_sock
 	struct ip6_addr raddr;
 	u16_t lport;
 	u16_t rport;
+	struct esix_ip_tmpl tmpl; //connected : how its packets start
 	u32_t seqn;
 	u32_t ackn;
-	u32_t rexmit_date; //date at which to trigger retransmission
-	struct sock_queue *queue; //stores sent/recvd data
+	u32_t snd_una; //first sequence number not acknowledged
+	u32_t snd_date; //date at which the data at snd_una was first sent
+	u32_t rexmit_date; //date at which to trigger retransmission (or leave FIN_WAIT_2)
+	u32_t ctl_date; //date at which our SYN or FIN was first sent
+	u8_t rexmits; //retransmission timeouts in a row, the timer doubles with each
+	u16_t flags; //SOCK_* negotiated/user options
+	u32_t sack_last; //seq number of the last out-of-order segment received
+	struct esix_block sack[ESIX_OOO_DEPHT]; //SACK scoreboard : sorted, disjoint, above snd_una
+	u8_t sack_n;
+	u32_t rexmit_high; //holes below were already resent
+	u32_t ecn_recover; //ECE only cuts cwnd again once past this is acknowledged
+	struct esix_block ooo[ESIX_OOO_DEPHT]; //out-of-order data sitting in rcv_ring past its len
+	u8_t ooo_n;
+	u8_t unacked_segs; //segments received since we last sent an ACK
+	struct esix_timer delack_timer; //delayed ACK
+	u16_t mss; //largest segment we send
+	u16_t snd_wnd; //window advertised by the peer
+	u32_t cwnd; //congestion window
+	u32_t ssthresh; //slow start threshold
+	struct esix_timer cork_timer; //bounds the time data stays corked
+	u32_t rcv_date; //date at which the last acceptable segment came in
+	struct esix_timer keep_timer; //next keepalive or idle timeout deadline
+	u16_t keep_idle; //idle time (s) before the first keepalive probe
+	u16_t keep_intvl; //time (s) between keepalive probes
+	u8_t keep_cnt; //unanswered probes before giving up
+	u8_t keep_probes; //unanswered probes sent so far
+	u32_t idle_timeout; //idle time (s) before aborting, 0 : never
+	u32_t rcv_timeo; //SO_RCVTIMEO (ms), 0 : no limit
+	const struct sock_callbacks *cb; //raw API callbacks, can be NULL
+	void *cb_arg;
+	u8_t ready; //POLL* events it's ready for
+	u8_t ready_edge; //POLL* events that came up since POLLET poll() reported them
+	u32_t snd_timeo; //SO_SNDTIMEO (ms), 0 : no limit
+	u8_t backlog; //LISTEN : max connections waiting in the accept queue
+	u8_t accept_len; //LISTEN : connections in the accept queue
+	int accept_head; //LISTEN : first socket of the accept queue, -1 if empty
+	int accept_next; //next socket in the listener's accept queue, -1 : last
+	int hash_next; //next socket in the same lookup table bucket, -1 : last
+	int port_next; //next socket in the same esix_port_hash bucket, -1 : last
+	u16_t snd_size; //SO_SNDBUF : send ring size, allocated when the connection starts (udp : max datagram)
+	u16_t rcv_size; //SO_RCVBUF : receive ring size, what we advertise as window (udp : queue size)
+	struct esix_ring snd_ring; //data from snd_una on : in flight, then not sent yet
+	struct esix_ring rcv_ring; //data from the last byte read to ackn
+	struct esix_sref *sref; //send_ref() buffers : send stream bytes not held in snd_ring
+	u32_t sref_len; //bytes of them not acknowledged yet
+	u32_t rtx_seqn; //[rtx_seqn, rtx_seqn + rtx_len[ : oldest segment in flight...
+	u32_t rtx_sum; //...and the sum of its payload, kept for retransmissions
+	u16_t rtx_len;
+	struct sock_queue *queue; //stores received udp datagrams
+	u16_t rcv_queued; //bytes of them
+	u32_t rcv_drops; //datagrams dropped for lack of room in the queue
+};
+
+//esix_sock flags
+#define SOCK_SACK_OK (1 << 0) //SACK-permitted negotiated on the SYN exchange
+#define SOCK_NODELAY (1 << 1) //TCP_NODELAY : Nagle's algorithm disabled
+#define SOCK_CORK (1 << 2) //TCP_CORK : only send full-sized segments
+#define SOCK_FIN_QUEUED (1 << 3) //close() called, FIN goes after the queued data
+#define SOCK_FIN_SENT (1 << 4) //FIN sent, it takes the sequence number before seqn
+#define SOCK_QUEUED (1 << 5) //in an accept queue, the slot can't be reused until accepted
+#define SOCK_HASHED (1 << 6) //in esix_listen_hash if LISTEN, in esix_conn_hash otherwise
+#define SOCK_KEEPALIVE (1 << 7) //SO_KEEPALIVE : probe the peer once idle
+#define SOCK_ECN_OK (1 << 8) //ECN negotiated on the SYN exchange (RFC 3168)
+#define SOCK_ECE (1 << 9) //congestion experienced : echo ECE until the peer sends CWR
+#define SOCK_CWR (1 << 10) //cwnd cut on ECE : the next new data carries CWR
+#define SOCK_REUSEADDR (1 << 11) //SO_REUSEADDR : udp port shared with the other sockets setting it
+
+//what's left of a tcp connection in TIME_WAIT, its socket is released
+struct esix_tw
+{
+	struct ip6_addr laddr;
+	struct ip6_addr raddr;
+	u16_t lport;
+	u16_t rport;
+	u32_t seqn; //next sequence number we'd send
+	u32_t ackn; //next sequence number we expect
+	u32_t expiration_date; //0 : free entry
+	int port_next; //next entry in the same esix_tw_port_hash bucket, -1 : last
+};
+
+//half-open tcp connection : SYN received and answered, no socket yet
+struct esix_syn
+{
+	struct ip6_addr laddr;
+	struct ip6_addr raddr;
+	u16_t lport;
+	u16_t rport;
+	u32_t seqn; //our ISN
+	u32_t ackn; //peer's ISN + 1
+	u16_t mss;
+	u16_t flags; //SOCK_SACK_OK, SOCK_ECN_OK
+	u8_t retries; //SYN|ACK retransmissions
+	int listener; //listening socket
+	u32_t rexmit_date; //0 : free entry
 };
 
 #define FIND_ANY 0
@@ -73,15 +184,52 @@ struct esix_sock
 #define FIND_LISTEN 2
 
 struct esix_sock esix_sockets[ESIX_MAX_SOCK];
-u16_t esix_last_port;
+struct esix_tw esix_tw_table[ESIX_MAX_TW];
+struct esix_syn esix_syn_table[ESIX_MAX_SYN];
+int esix_conn_hash[ESIX_SOCK_HASH]; //connected sockets, keyed on the 4-tuple and protocol
+int esix_listen_hash[ESIX_SOCK_HASH]; //listening sockets, keyed on the local port
+int esix_port_hash[ESIX_SOCK_HASH]; //every open socket, keyed on its local port and protocol
+int esix_tw_port_hash[ESIX_SOCK_HASH]; //TIME_WAIT entries, keyed on their local port
+
+//a multicast group a socket joined
+struct esix_mship
+{
+	struct ip6_addr group;
+	int sock; //-1 : free entry
+	u8_t added; //the group went in the address table for this membership
+};
+
+struct esix_mship esix_mships[ESIX_MAX_MSHIP];
 
-int esix_port_available(const u16_t);
-int esix_socket_create_child(const struct ip6_addr *, const struct ip6_addr *, u16_t, u16_t, u8_t);
+int esix_port_available(u16_t, u8_t);
+void esix_socket_set_port(int, u16_t);
+void esix_socket_tw_free(int);
+int esix_socket_create_child(int, const struct ip6_addr *, const struct ip6_addr *, u16_t, u16_t);
+void esix_socket_hash(int);
+void esix_socket_unhash(int);
+void esix_socket_release(int);
 int esix_find_socket(const struct ip6_addr *, const struct ip6_addr *, u16_t, u16_t, u8_t, u8_t);
-int esix_queue_data(int, const void *, int, struct sockaddr_in6 *, enum direction);
+int esix_queue_data(int, const void *, int, struct sockaddr_in6 *);
+int esix_queue_mcast(const struct ip6_addr *, u16_t, const void *, int, struct sockaddr_in6 *);
 struct sock_queue * esix_socket_find_e(int , enum qe_type, enum action);
 void esix_socket_init();
 void esix_socket_free_queue(int);
-int esix_socket_expire_e(int, u32_t);
+int esix_socket_flight(int);
+void esix_socket_keepalive(int);
+void esix_socket_wake(int);
+int esix_socket_raw_recv(int, const void *, int, const struct sockaddr_in6 *);
+void esix_socket_raw_accept(int, int);
+void esix_socket_lost(int);
+u32_t esix_socket_snd_len(int);
+void esix_socket_snd_get(int, u32_t, void *, int);
+int esix_socket_expire(int, u32_t);
+int esix_socket_queue_ooo(int, const void *, int, u32_t);
+int esix_socket_queue_stream(int, const void *, int);
+int esix_socket_sack(int, u32_t, u32_t);
+void esix_socket_rexmit_holes(int, int);
+void esix_socket_time_wait(int);
+int esix_socket_find_tw(const struct ip6_addr *, const struct ip6_addr *, u16_t, u16_t);
+int esix_socket_new_syn(int);
+int esix_socket_find_syn(const struct ip6_addr *, const struct ip6_addr *, u16_t, u16_t);
 void esix_socket_housekeep();
 #endif
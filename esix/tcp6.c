@@ -33,9 +33,713 @@
 #include "include/socket.h"
 #include "socket.h"
 
+/*
+ * Option fields aren't aligned, read/write them byte by byte.
+ */
+static u32_t esix_tcp_get32(const u8_t *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void esix_tcp_put32(u8_t *p, u32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/*
+ * Walks the options of a received segment. MSS and SACK-permitted are only
+ * looked at on SYNs, SACK blocks update the scoreboard of sock (if any).
+ */
+static void esix_tcp_walk_options(const struct tcp_hdr *t_hdr, u16_t *mss, u16_t *flags, const int sock)
+{
+	int i, val;
+	const u8_t *opt = (const u8_t *) (t_hdr + 1);
+	const u8_t *end = (const u8_t *) t_hdr + (t_hdr->data_offset>>4)*4;
+
+	while(opt < end)
+	{
+		if(*opt == TCP_OPT_EOL)
+			return;
+		if(*opt == TCP_OPT_NOP)
+		{
+			opt++;
+			continue;
+		}
+
+		//malformed option, don't go any further
+		if(opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end)
+			return;
+
+		switch(*opt)
+		{
+			case TCP_OPT_MSS:
+				//the largest segment the peer takes, never more than we could send
+				if(!(t_hdr->flags & SYN) || opt[1] != 4)
+					break;
+
+				val = (opt[2] << 8) | opt[3];
+				if(val > TCP_LOCAL_MSS)
+					val = TCP_LOCAL_MSS;
+				if(val >= 64)
+					*mss = val;
+			break;
+
+			case TCP_OPT_SACK_PERM:
+				if(t_hdr->flags & SYN)
+					*flags |= SOCK_SACK_OK;
+			break;
+
+			case TCP_OPT_SACK:
+				if(sock < 0 || !(*flags & SOCK_SACK_OK))
+					break;
+
+				for(i = 2; i + 8 <= opt[1]; i += 8)
+					esix_socket_sack(sock, esix_tcp_get32(opt + i), esix_tcp_get32(opt + i + 4));
+			break;
+
+			default:
+			break;
+		}
+		opt += opt[1];
+	}
+}
+
+void esix_tcp_process_options(const int sock, const struct tcp_hdr *t_hdr)
+{
+	esix_tcp_walk_options(t_hdr, &esix_sockets[sock].mss, &esix_sockets[sock].flags, sock);
+
+	if(t_hdr->flags & SYN)
+		esix_sockets[sock].cwnd = TCP_INIT_CWND(esix_sockets[sock].mss);
+}
+
+/*
+ * Builds the options of a SYN : our MSS, and SACK-permitted if sack is set.
+ * Returns the options length.
+ */
+static int esix_tcp_syn_opts(u8_t *opts, int sack)
+{
+	opts[0] = TCP_OPT_MSS;
+	opts[1] = 4;
+	opts[2] = TCP_LOCAL_MSS >> 8;
+	opts[3] = TCP_LOCAL_MSS & 0xff;
+
+	if(!sack)
+		return 4;
+
+	opts[4] = TCP_OPT_NOP;
+	opts[5] = TCP_OPT_NOP;
+	opts[6] = TCP_OPT_SACK_PERM;
+	opts[7] = 2;
+	return 8;
+}
+
+/*
+ * Acknowledges received data (RFC 1122 4.2.3.2) : every second segment, or
+ * when the delayed ACK timer fires, unless now is set. Any segment we send
+ * in the meantime carries the ACK.
+ */
+static void esix_tcp_delay_ack(int sock, int now)
+{
+	if(now || ++esix_sockets[sock].unacked_segs >= 2)
+		esix_tcp_send_segment(sock, esix_sockets[sock].seqn, ACK, NULL, 0);
+	else if(!esix_timer_pending(&esix_sockets[sock].delack_timer))
+		esix_timer_start(&esix_sockets[sock].delack_timer, ESIX_DELACK_MS);
+}
+
+void esix_tcp_delack_timeout(int sock)
+{
+	if(esix_sockets[sock].proto == SOCK_STREAM &&
+		esix_sockets[sock].unacked_segs > 0 &&
+		esix_sockets[sock].state != CLOSED &&
+		esix_sockets[sock].state != RESERVED)
+		esix_tcp_send_segment(sock, esix_sockets[sock].seqn, ACK, NULL, 0);
+}
+
+/*
+ * Room left in the receive ring : the window we advertise.
+ */
+static u16_t esix_tcp_rcv_wnd(int sock)
+{
+	return esix_sockets[sock].rcv_ring.size - esix_sockets[sock].rcv_ring.len;
+}
+
+/*
+ * Called once the application read from the receive ring, wnd being the
+ * window before that. Announces the window when it opens up enough for
+ * a full segment or half the ring (RFC 1122 4.2.3.3), the peer might be
+ * waiting for it.
+ */
+void esix_tcp_window_update(int sock, u16_t wnd)
+{
+	u16_t min = TCP_LOCAL_MSS;
+
+	if(esix_sockets[sock].rcv_ring.size / 2 < min)
+		min = esix_sockets[sock].rcv_ring.size / 2;
+
+	if(esix_sockets[sock].state == ESTABLISHED &&
+		wnd < min && esix_tcp_rcv_wnd(sock) >= min)
+		esix_tcp_send_segment(sock, esix_sockets[sock].seqn, ACK, NULL, 0);
+}
+
+/*
+ * Takes the window advertised on an acceptable ACK and grows the congestion
+ * window (RFC 5681) by what it acknowledges : up to one MSS per ACK in
+ * slow start, about one MSS per round trip past ssthresh.
+ */
+static void esix_tcp_ack_wnd(int sock, const struct tcp_hdr *t_hdr)
+{
+	u32_t una = esix_sockets[sock].snd_una, ackn = ntoh32(t_hdr->ackn), acked;
+
+	//only trust ACKs for what we actually sent
+	if(SEQ_LT(ackn, una) || SEQ_GT(ackn, esix_sockets[sock].seqn))
+		return;
+
+	esix_sockets[sock].snd_wnd = ntoh16(t_hdr->w_size);
+
+	if((acked = ackn - una) == 0)
+		return;
+	if(acked > esix_sockets[sock].mss)
+		acked = esix_sockets[sock].mss;
+
+	if(esix_sockets[sock].cwnd < esix_sockets[sock].ssthresh)
+		esix_sockets[sock].cwnd += acked;
+	else
+		esix_sockets[sock].cwnd += esix_sockets[sock].mss * esix_sockets[sock].mss /
+			esix_sockets[sock].cwnd + 1;
+}
+
+/*
+ * Reacts to a loss (RFC 5681) : halves the congestion window when the SACK
+ * scoreboard reveals a hole, falls back to slow start on timeout.
+ */
+void esix_tcp_congestion(int sock, int timeout)
+{
+	u32_t flight = esix_sockets[sock].seqn - esix_sockets[sock].snd_una;
+
+	esix_sockets[sock].ssthresh = flight / 2;
+	if(esix_sockets[sock].ssthresh < 2*esix_sockets[sock].mss)
+		esix_sockets[sock].ssthresh = 2*esix_sockets[sock].mss;
+
+	if(timeout)
+		esix_sockets[sock].cwnd = esix_sockets[sock].mss;
+	else
+		esix_sockets[sock].cwnd = esix_sockets[sock].ssthresh;
+}
+
+/*
+ * The most payload the next segment of a socket can carry. The MSS doesn't
+ * account for options (RFC 6691) : the SACK blocks it will bear come out of it.
+ */
+u16_t esix_tcp_seg_size(int sock)
+{
+	int n = esix_sockets[sock].ooo_n;
+
+	if(!(esix_sockets[sock].flags & SOCK_SACK_OK) || n == 0)
+		return esix_sockets[sock].mss;
+
+	if(n > TCP_MAX_SACK_BLOCKS)
+		n = TCP_MAX_SACK_BLOCKS;
+	return esix_sockets[sock].mss - (4 + 8*n);
+}
+
+/*
+ * Sends the data waiting in the send ring that is allowed to leave, cut in
+ * segments of at most one MSS, SACK option included. Segments never go past the peer window nor
+ * the congestion window. Nagle's algorithm (RFC 896) holds a sub-MSS
+ * segment back while we have unacknowledged data in flight, unless
+ * TCP_NODELAY is set. TCP_CORK holds it back until it fills up or
+ * ESIX_CORK_MS elapsed. push lets everything go regardless. Once the
+ * socket is closed and everything left, the FIN goes.
+ */
+void esix_tcp_output(int sock, int push)
+{
+	u32_t wnd, flight;
+	int unsent, len, mss;
+	u8_t flags;
+
+	//data can leave until our FIN does
+	switch(esix_sockets[sock].state)
+	{
+		case ESTABLISHED:
+		case CLOSE_WAIT:
+		case FIN_WAIT_1:
+		case CLOSING:
+		case LAST_ACK:
+		break;
+		default :
+		return;
+	}
+	if(esix_sockets[sock].flags & SOCK_FIN_SENT)
+		return;
+
+	while((unsent = esix_socket_snd_len(sock) - esix_socket_flight(sock)) > 0)
+	{
+		len = unsent;
+		mss = esix_tcp_seg_size(sock);
+		if(len > mss)
+			len = mss;
+
+		//what both the peer and the network can take
+		wnd = esix_sockets[sock].cwnd;
+		if(esix_sockets[sock].snd_wnd < wnd)
+			wnd = esix_sockets[sock].snd_wnd;
+		flight = esix_sockets[sock].seqn - esix_sockets[sock].snd_una;
+
+		if(flight + len > wnd)
+		{
+			//with nothing in flight, send what fits rather than wait forever.
+			//on a zero window, let the housekeeper probe it.
+			if(flight > 0 || wnd == 0)
+			{
+				if(flight == 0 && esix_sockets[sock].rexmit_date == 0)
+					esix_sockets[sock].rexmit_date = esix_get_time() + 2;
+				return;
+			}
+			len = wnd;
+		}
+
+		if(len < mss && !push)
+		{
+			if(esix_sockets[sock].flags & SOCK_CORK)
+			{
+				if(!esix_timer_pending(&esix_sockets[sock].cork_timer))
+					esix_timer_start(&esix_sockets[sock].cork_timer, ESIX_CORK_MS);
+				return;
+			}
+
+			if(!(esix_sockets[sock].flags & SOCK_NODELAY) && flight > 0)
+				return;
+		}
+
+		//push the last segment we have
+		flags = ACK;
+		if(len == unsent)
+			flags |= PSH;
+
+		if(flight == 0)
+			esix_sockets[sock].snd_date = esix_get_time();
+
+		esix_tcp_send_segment(sock, esix_sockets[sock].seqn, flags, NULL, len);
+		esix_sockets[sock].seqn += len;
+		esix_sockets[sock].rexmit_date = esix_get_time() + 2;
+	}
+
+	esix_timer_stop(&esix_sockets[sock].cork_timer);
+
+	//closing : the FIN follows the last queued byte
+	if(esix_sockets[sock].flags & SOCK_FIN_QUEUED)
+	{
+		esix_tcp_send_segment(sock, esix_sockets[sock].seqn, FIN|ACK, NULL, 0);
+		esix_sockets[sock].seqn++;
+		esix_sockets[sock].flags |= SOCK_FIN_SENT;
+		esix_sockets[sock].ctl_date = esix_get_time();
+		esix_sockets[sock].rexmit_date = esix_get_time() + 2;
+	}
+}
+
+void esix_tcp_cork_timeout(int sock)
+{
+	if(esix_sockets[sock].proto == SOCK_STREAM)
+		esix_tcp_output(sock, 1);
+}
+
+/*
+ * Answers a segment that doesn't belong to any connection with a RST
+ * (RFC 9293 3.10.7.1). Never answer a RST.
+ */
+static void esix_tcp_reset(const struct tcp_hdr *t_hdr, const struct ip6_hdr *ip_hdr, int dlen)
+{
+	if(t_hdr->flags & RST)
+		return;
+
+	if(t_hdr->flags & ACK)
+		esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
+			ntoh32(t_hdr->ackn), 0, RST, NULL, 0);
+	else
+		esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
+			0, ntoh32(t_hdr->seqn) + dlen + ((t_hdr->flags & SYN) != 0) + ((t_hdr->flags & FIN) != 0),
+			RST|ACK, NULL, 0);
+}
+
+/*
+ * A segment for a connection in TIME_WAIT. We only acknowledge a FIN the peer
+ * retransmits (restarting the 2 MSL timer) or anything carrying data, and
+ * never let a RST cut TIME_WAIT short (RFC 1337). A new SYN past what the old
+ * connection received can reuse it right away : returns 0 if the segment
+ * should go on to a listening socket.
+ */
+static int esix_tcp_tw_process(int tw, const struct tcp_hdr *t_hdr, int dlen)
+{
+	struct esix_tw *e = &esix_tw_table[tw];
+
+	if(t_hdr->flags & RST)
+		return 1;
+
+	if((t_hdr->flags & (SYN|ACK)) == SYN && SEQ_GT(ntoh32(t_hdr->seqn), e->ackn))
+	{
+		esix_socket_tw_free(tw);
+		return 0;
+	}
+
+	if(t_hdr->flags & FIN)
+		e->expiration_date = esix_get_time() + 2*ESIX_MSL;
+
+	if((t_hdr->flags & (SYN|FIN)) || dlen > 0)
+		esix_tcp_send(&e->laddr, &e->raddr, e->lport, e->rport, e->seqn, e->ackn, ACK, NULL, 0);
+
+	return 1;
+}
+
+/*
+ * Tells whether a segment overlaps our receive window (RFC 9293 3.10.7.4).
+ */
+static int esix_tcp_acceptable(int sock, u32_t seqn, int dlen)
+{
+	u32_t rcv_nxt = esix_sockets[sock].ackn;
+	u16_t wnd = esix_tcp_rcv_wnd(sock);
+
+	//nothing but an empty segment at rcv_nxt on a zero window
+	if(wnd == 0)
+		return dlen == 0 && seqn == rcv_nxt;
+
+	if(SEQ_GEQ(seqn, rcv_nxt) && SEQ_LT(seqn, rcv_nxt + wnd))
+		return 1;
+
+	return dlen > 0 && SEQ_GEQ(seqn + dlen - 1, rcv_nxt) &&
+		SEQ_LT(seqn + dlen - 1, rcv_nxt + wnd);
+}
+
+/*
+ * SYN cookies (RFC 4987) : when a listening socket can't keep any more
+ * half-open connections, the ISN we answer with encodes a 64s counter
+ * (5 bits), the peer MSS (2 bits) and a keyed hash of the connection
+ * (25 bits), so that the ACK completing the handshake brings back all we need.
+ */
+static const u16_t esix_tcp_cookie_mss[4] = {536, 1000, 1220, TCP_LOCAL_MSS};
+static u32_t esix_tcp_cookie_secret;
+
+static u32_t esix_tcp_cookie_hash(const struct tcp_hdr *t_hdr, const struct ip6_hdr *ip_hdr, u32_t irs, u32_t t)
+{
+	u32_t h;
+
+	if(esix_tcp_cookie_secret == 0)
+		esix_tcp_cookie_secret = esix_random();
+
+	//source and destination addresses, then ports, are contiguous
+	h = esix_hash(&ip_hdr->saddr, 32, esix_tcp_cookie_secret);
+	h = esix_hash(&t_hdr->s_port, 4, h);
+	h = esix_hash(&irs, 4, h);
+	return esix_hash(&t, 4, h) & 0x1ffffff;
+}
+
+static u32_t esix_tcp_make_cookie(const struct tcp_hdr *t_hdr, const struct ip6_hdr *ip_hdr, u16_t mss)
+{
+	u32_t t = esix_get_time() >> 6;
+	int i = 3;
+
+	//the largest MSS we can encode that the peer takes
+	while(i > 0 && esix_tcp_cookie_mss[i] > mss)
+		i--;
+
+	return ((t & 0x1f) << 27) | (i << 25) |
+		esix_tcp_cookie_hash(t_hdr, ip_hdr, ntoh32(t_hdr->seqn), t);
+}
+
+/*
+ * Checks the cookie an ACK brings back. It's valid for one to two counter
+ * periods. Returns the MSS it encodes, 0 if it's not valid.
+ */
+static u16_t esix_tcp_check_cookie(const struct tcp_hdr *t_hdr, const struct ip6_hdr *ip_hdr)
+{
+	u32_t cookie = ntoh32(t_hdr->ackn) - 1;
+	u32_t now = esix_get_time() >> 6, t;
+
+	t = now - ((now - (cookie >> 27)) & 0x1f);
+	if(now - t > 1)
+		return 0;
+
+	if((cookie & 0x1ffffff) != esix_tcp_cookie_hash(t_hdr, ip_hdr, ntoh32(t_hdr->seqn) - 1, t))
+		return 0;
+
+	return esix_tcp_cookie_mss[(cookie >> 25) & 3];
+}
+
+/*
+ * Sends (or resends) the SYN|ACK of a half-open connection.
+ */
+void esix_tcp_send_synack(int syn)
+{
+	u8_t opts[TCP_MAX_OPT_LEN];
+	struct esix_syn *e = &esix_syn_table[syn];
+
+	esix_tcp_send_opts(&e->laddr, &e->raddr, e->lport, e->rport, e->seqn, e->ackn,
+		SYN|ACK|((e->flags & SOCK_ECN_OK) ? ECE : 0), esix_sockets[e->listener].rcv_size, opts, esix_tcp_syn_opts(opts, e->flags & SOCK_SACK_OK), NULL, 0);
+}
+
+/*
+ * A SYN reached a listening socket. It only costs a half-open connection
+ * entry, the socket is created when the handshake completes. Past the
+ * listener backlog or when the table is full, answer with a SYN cookie.
+ * A full accept queue means the application can't keep up : drop the SYN,
+ * the peer retries. tw is the TIME_WAIT entry the connection replaces, if any.
+ */
+static void esix_tcp_listen(const struct tcp_hdr *t_hdr, const struct ip6_hdr *ip_hdr, int tw)
+{
+	int l, syn;
+	u16_t mss = TCP_DEFAULT_MSS;
+	u16_t flags = 0;
+	u8_t opts[TCP_MAX_OPT_LEN];
+	struct esix_syn *e;
+
+	if((l = esix_find_socket(&ip_hdr->saddr, &ip_hdr->daddr, t_hdr->s_port,
+		t_hdr->d_port, SOCK_STREAM, FIND_LISTEN)) < 0)
+	{
+		esix_tcp_reset(t_hdr, ip_hdr, 0);
+		return;
+	}
+
+	if(esix_sockets[l].accept_len >= esix_sockets[l].backlog)
+		return;
+
+	//our SYN|ACK got lost and the peer resent its SYN
+	if((syn = esix_socket_find_syn(&ip_hdr->saddr, &ip_hdr->daddr, t_hdr->s_port, t_hdr->d_port)) >= 0 &&
+		esix_syn_table[syn].ackn == ntoh32(t_hdr->seqn)+1)
+	{
+		esix_tcp_send_synack(syn);
+		return;
+	}
+
+	esix_random_stir(ntoh32(t_hdr->seqn));
+	esix_tcp_walk_options(t_hdr, &mss, &flags, -1);
+
+	//an ECN-setup SYN (RFC 3168 6.1.1). a cookie can't remember it.
+	if((t_hdr->flags & (ECE|CWR)) == (ECE|CWR))
+		flags |= SOCK_ECN_OK;
+
+	//a new SYN replaces a stale half-open connection
+	if(syn < 0 && (syn = esix_socket_new_syn(l)) < 0)
+	{
+		esix_tcp_send_opts(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
+			esix_tcp_make_cookie(t_hdr, ip_hdr, mss), ntoh32(t_hdr->seqn)+1, SYN|ACK,
+			esix_sockets[l].rcv_size, opts, esix_tcp_syn_opts(opts, 0), NULL, 0);
+		return;
+	}
+
+	e = &esix_syn_table[syn];
+	esix_memcpy(&e->laddr, &ip_hdr->daddr, 16);
+	esix_memcpy(&e->raddr, &ip_hdr->saddr, 16);
+	e->lport	= t_hdr->d_port;
+	e->rport	= t_hdr->s_port;
+	e->ackn		= ntoh32(t_hdr->seqn)+1;
+	e->mss		= mss;
+	e->flags	= flags;
+	e->retries	= 0;
+	e->rexmit_date	= esix_get_time() + 2;
+
+	//start past anything the old incarnation could have sent
+	if(tw >= 0)
+		e->seqn = esix_tw_table[tw].seqn + 65536;
+	else
+		e->seqn = esix_random();
+
+	esix_tcp_send_synack(syn);
+}
+
+/*
+ * An ACK for a connection we don't know : it might complete a passive open,
+ * either from the half-open table or bringing back a SYN cookie. Creates the
+ * socket and queues it for accept(). Returns -1 if the segment is dealt with.
+ */
+static int esix_tcp_passive_open(const struct tcp_hdr *t_hdr, const struct ip6_hdr *ip_hdr, int dlen)
+{
+	int l, syn, s;
+	u16_t mss;
+	u16_t flags = 0;
+
+	if((t_hdr->flags & (SYN|RST|ACK)) != ACK ||
+		(l = esix_find_socket(&ip_hdr->saddr, &ip_hdr->daddr, t_hdr->s_port,
+		t_hdr->d_port, SOCK_STREAM, FIND_LISTEN)) < 0)
+	{
+		esix_tcp_reset(t_hdr, ip_hdr, dlen);
+		return -1;
+	}
+
+	if((syn = esix_socket_find_syn(&ip_hdr->saddr, &ip_hdr->daddr, t_hdr->s_port, t_hdr->d_port)) >= 0)
+	{
+		if(ntoh32(t_hdr->ackn) != esix_syn_table[syn].seqn + 1 ||
+			ntoh32(t_hdr->seqn) != esix_syn_table[syn].ackn)
+		{
+			esix_tcp_reset(t_hdr, ip_hdr, dlen);
+			return -1;
+		}
+		mss	= esix_syn_table[syn].mss;
+		flags	= esix_syn_table[syn].flags;
+	}
+	else if((mss = esix_tcp_check_cookie(t_hdr, ip_hdr)) == 0)
+	{
+		esix_tcp_reset(t_hdr, ip_hdr, dlen);
+		return -1;
+	}
+
+	//no room in the accept queue : the peer will retransmit
+	if((s = esix_socket_create_child(l, &ip_hdr->saddr, &ip_hdr->daddr,
+		t_hdr->s_port, t_hdr->d_port)) < 0)
+		return -1;
+
+	if(syn >= 0)
+		esix_syn_table[syn].rexmit_date = 0;
+
+	esix_sockets[s].state	= ESTABLISHED;
+	esix_sockets[s].seqn	= ntoh32(t_hdr->ackn);
+	esix_sockets[s].snd_una	= esix_sockets[s].seqn;
+	esix_sockets[s].rexmit_high = esix_sockets[s].seqn;
+	esix_sockets[s].ecn_recover = esix_sockets[s].seqn;
+	esix_sockets[s].ackn	= ntoh32(t_hdr->seqn);
+	esix_sockets[s].mss	= mss;
+	esix_sockets[s].cwnd	= TCP_INIT_CWND(mss);
+	esix_sockets[s].flags	|= flags;
+	esix_socket_keepalive(s);
+	esix_socket_wake(s);
+	esix_socket_raw_accept(l, s);
+
+	return s;
+}
+
+/*
+ * We sent a SYN, wait for the peer's.
+ */
+static void esix_tcp_syn_sent(int s, const struct tcp_hdr *t_hdr, const struct ip6_hdr *ip_hdr, int dlen)
+{
+	//it has to acknowledge our SYN
+	if((t_hdr->flags & ACK) && ntoh32(t_hdr->ackn) != esix_sockets[s].seqn)
+	{
+		esix_tcp_reset(t_hdr, ip_hdr, dlen);
+		return;
+	}
+
+	//connection refused
+	if(t_hdr->flags & RST)
+	{
+		if(t_hdr->flags & ACK)
+		{
+			esix_socket_lost(s);
+		}
+		return;
+	}
+
+	if(!(t_hdr->flags & SYN))
+		return;
+
+	esix_sockets[s].ackn = ntoh32(t_hdr->seqn)+1;
+	esix_sockets[s].snd_wnd = ntoh16(t_hdr->w_size);
+	esix_tcp_process_options(s, t_hdr);
+
+	if(t_hdr->flags & ACK)
+	{
+		//the peer agreed to ECN
+		if((t_hdr->flags & (ECE|CWR)) == ECE)
+			esix_sockets[s].flags |= SOCK_ECN_OK;
+
+		esix_sockets[s].state = ESTABLISHED;
+		esix_sockets[s].snd_una = esix_sockets[s].seqn;
+		esix_sockets[s].rexmit_high = esix_sockets[s].seqn;
+		esix_sockets[s].ecn_recover = esix_sockets[s].seqn;
+		esix_sockets[s].rexmits = 0;
+		esix_sockets[s].rexmit_date = 0;
+		esix_sockets[s].rcv_date = esix_get_time();
+		esix_socket_keepalive(s);
+		esix_socket_wake(s);
+		esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
+		esix_tcp_output(s, 0);
+	}
+	else
+	{
+		//simultaneous open
+		esix_sockets[s].state = SYN_RECEIVED;
+		esix_tcp_send_segment(s, esix_sockets[s].seqn - 1, SYN|ACK, NULL, 0);
+	}
+}
+
+/*
+ * Control flags of the SYN or FIN we sent and the peer has yet to
+ * acknowledge, 0 if there's none. It always is the last thing we sent.
+ */
+u8_t esix_tcp_ctl_unacked(int sock)
+{
+	switch(esix_sockets[sock].state)
+	{
+		case SYN_SENT:
+			return SYN;
+		case SYN_RECEIVED:
+			return SYN|ACK;
+		case FIN_WAIT_1:
+		case CLOSING:
+		case LAST_ACK:
+			if(esix_sockets[sock].flags & SOCK_FIN_SENT)
+				return FIN|ACK;
+		default:
+			return 0;
+	}
+}
+
+/*
+ * Header prediction (Van Jacobson) : on an established connection, most
+ * segments either only acknowledge the next bytes we sent, or carry the
+ * next bytes we expect and acknowledge nothing new. Both take a few
+ * comparisons and skip the general path. Anything else (options, flags
+ * other than ACK and PSH, window change, CE mark, SACK or reassembly
+ * going on) returns 0 and goes the long way.
+ */
+static int esix_tcp_predict(int s, const struct tcp_hdr *t_hdr, const struct ip6_hdr *ip_hdr, const u8_t *data, int dlen)
+{
+	u32_t ackn = ntoh32(t_hdr->ackn);
+
+	if(esix_sockets[s].state != ESTABLISHED ||
+		(t_hdr->flags & ~PSH) != ACK ||
+		t_hdr->data_offset != (sizeof(struct tcp_hdr) / 4) << 4 ||
+		ntoh32(t_hdr->seqn) != esix_sockets[s].ackn ||
+		ntoh16(t_hdr->w_size) != esix_sockets[s].snd_wnd ||
+		IP6_ECN(ip_hdr) == ECN_CE)
+		return 0;
+
+	if(dlen == 0)
+	{
+		//pure ACK for new data
+		if(!SEQ_GT(ackn, esix_sockets[s].snd_una) || SEQ_GT(ackn, esix_sockets[s].seqn) ||
+			esix_sockets[s].sack_n > 0)
+			return 0;
+
+		esix_sockets[s].rcv_date = esix_get_time();
+		esix_tcp_ack_wnd(s, t_hdr);
+		esix_socket_expire(s, ackn);
+		esix_tcp_output(s, 0);
+		return 1;
+	}
+
+	//in-order data that fits, nothing new acknowledged
+	if(ackn != esix_sockets[s].snd_una || esix_sockets[s].ooo_n > 0 ||
+		dlen > esix_tcp_rcv_wnd(s))
+		return 0;
+
+	esix_sockets[s].rcv_date = esix_get_time();
+	esix_socket_queue_stream(s, data, dlen);
+	esix_tcp_delay_ack(s, 0);
+	return 1;
+}
+
+/*
+ * Segment arrival (RFC 9293 3.10.7). Flags are looked at one by one, so that
+ * any combination of them is handled.
+ */
 void esix_tcp_process(const struct tcp_hdr *t_hdr, const int len, const struct ip6_hdr *ip_hdr)
 {
-	int session_sock;
+	int s, tw, hlen, dlen, ooo, ce = 0;
+	u32_t seqn, ackn;
+	const u8_t *data;
+	u8_t flags;
 
 	//do we have enough bytes to proces the header?
 	if(len < 20)
@@ -48,191 +752,446 @@ void esix_tcp_process(const struct tcp_hdr *t_hdr, const int len, const struct i
 	if(esix_ip_upper_checksum(&ip_hdr->saddr, &ip_hdr->daddr, TCP, t_hdr, len) != 0)
 		return;
 
-	switch (t_hdr->flags)
+	//the header (options included) must fit in the segment
+	hlen = (t_hdr->data_offset>>4)*4;
+	if(hlen < sizeof(struct tcp_hdr) || hlen > len)
+		return;
+
+	data	= (const u8_t *) t_hdr + hlen;
+	dlen	= len - hlen;
+	seqn	= ntoh32(t_hdr->seqn);
+	ackn	= ntoh32(t_hdr->ackn);
+	flags	= t_hdr->flags;
+
+	//segments go to their connection first, to what's left of it
+	//if it's in TIME_WAIT, then to a listening socket
+	if((s = esix_find_socket(&ip_hdr->saddr, &ip_hdr->daddr, 
+		t_hdr->s_port, t_hdr->d_port, SOCK_STREAM, FIND_CONNECTED)) < 0)
 	{
-		case SYN:
-			//try to create a child connection. if if fails, send a RST|ACK right away.
-			if((session_sock = esix_socket_create_child(&ip_hdr->saddr, &ip_hdr->daddr, 
-				t_hdr->s_port, t_hdr->d_port, SOCK_STREAM)) < 0)
-			{
-				esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-					ntoh32(t_hdr->ackn)+1, ntoh32(t_hdr->seqn)+1, RST|ACK, NULL, 0);
-				return;
-			}
+		if((tw = esix_socket_find_tw(&ip_hdr->saddr, &ip_hdr->daddr,
+			t_hdr->s_port, t_hdr->d_port)) >= 0 &&
+			esix_tcp_tw_process(tw, t_hdr, dlen))
+			return;
 
-			esix_sockets[session_sock].state = SYN_RECEIVED;
-			esix_sockets[session_sock].ackn = ntoh32(t_hdr->seqn)+1;
-			esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-				esix_sockets[session_sock].seqn, esix_sockets[session_sock].ackn, SYN|ACK, NULL, 0);
-			esix_sockets[session_sock].seqn++;
+		if((flags & (SYN|ACK|RST)) == SYN)
+		{
+			esix_tcp_listen(t_hdr, ip_hdr, tw);
+			return;
+		}
 
-		break;
+		//the ACK completing a passive open creates the socket
+		if((s = esix_tcp_passive_open(t_hdr, ip_hdr, dlen)) < 0)
+			return;
+	}
+	else if(esix_tcp_predict(s, t_hdr, ip_hdr, data, dlen))
+		return;
 
-		case SYN|ACK:
-			if((session_sock = esix_find_socket(&ip_hdr->saddr, &ip_hdr->daddr, 
-				t_hdr->s_port, t_hdr->d_port, SOCK_STREAM, FIND_CONNECTED)) < 0)
-			{
-				esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-					ntoh32(t_hdr->ackn)+1, ntoh32(t_hdr->seqn)+1, RST|ACK, NULL, 0);
-				return;
-			}
+	if(esix_sockets[s].state == SYN_SENT)
+	{
+		esix_tcp_syn_sent(s, t_hdr, ip_hdr, dlen);
+		return;
+	}
 
-			//put the socket in established mode and store remote node's seq number
-			if(ntoh32(t_hdr->ackn) == esix_sockets[session_sock].seqn)
-			{
-				if(esix_sockets[session_sock].state == SYN_SENT)
-					esix_sockets[session_sock].state = ESTABLISHED;
+	//first check the sequence number
+	if(!esix_tcp_acceptable(s, seqn, dlen))
+	{
+		if(flags & RST)
+			return;
 
-				esix_sockets[session_sock].ackn = ntoh32(t_hdr->ackn)+1;
-				esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-					esix_sockets[session_sock].seqn, esix_sockets[session_sock].ackn, ACK, NULL, 0);
+		//our SYN|ACK got lost and the peer resent its SYN
+		if(esix_sockets[s].state == SYN_RECEIVED && (flags & SYN))
+		{
+			esix_tcp_send_segment(s, esix_sockets[s].seqn - 1, SYN|ACK, NULL, 0);
+			return;
+		}
 
-			}
-			
-		break;
+		//otherwise, late, retransmitted packet
+		esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
+		return;
+	}
 
-		case ACK:
-		case PSH|ACK:
-		case CWR|PSH|ACK:
-			if((session_sock = esix_find_socket(&ip_hdr->saddr, &ip_hdr->daddr, 
-				t_hdr->s_port, t_hdr->d_port, SOCK_STREAM, FIND_CONNECTED)) < 0)  
-			{
-				esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-					ntoh32(t_hdr->ackn), ntoh32(t_hdr->seqn), RST|ACK, NULL, 0);
-				return;
-			}
+	//the peer is alive : keepalive and idle timeout count from now
+	esix_sockets[s].rcv_date = esix_get_time();
 
-			//remove every ack'ed packet from our send queue
-			esix_socket_expire_e(session_sock, ntoh32(t_hdr->ackn));
-			
-			//packet sequence OK
-			if(ntoh32(t_hdr->seqn) == esix_sockets[session_sock].ackn)
-			{
-				switch(esix_sockets[session_sock].state)
-				{
-					case SYN_RECEIVED:
-						esix_sockets[session_sock].state = ESTABLISHED;
-					break;
-					case FIN_WAIT_2:
-						esix_socket_free_queue(session_sock);
-						esix_sockets[session_sock].state = CLOSED;
-					break;
-					case ESTABLISHED:
-						//grab received data, if any
-						if((len-((t_hdr->data_offset>>4)*4)) >0)
-						{
-							if((esix_queue_data(session_sock, (u8_t*) t_hdr + ((t_hdr->data_offset>>4)*4) ,
-									len-(t_hdr->data_offset>>4)*4, NULL, IN)) <0 )
-								return;
-							esix_sockets[session_sock].ackn += len-((t_hdr->data_offset>>4)*4);
-							esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-								esix_sockets[session_sock].seqn, esix_sockets[session_sock].ackn, ACK, NULL, 0);
-						}
-					break;
-					default :
-					break;
-				}
+	//a router marked it : echo ECE until the peer tells it slowed down
+	if(esix_sockets[s].flags & SOCK_ECN_OK)
+	{
+		if(flags & CWR)
+			esix_sockets[s].flags &= ~SOCK_ECE;
+		if(IP6_ECN(ip_hdr) == ECN_CE)
+		{
+			esix_sockets[s].flags |= SOCK_ECE;
+			ce = 1;
+		}
+	}
 
-			}
-			else
-			{
-				//late, retransmitted packet
-				esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-					esix_sockets[session_sock].seqn, esix_sockets[session_sock].ackn, ACK, NULL, 0);
-			}
+	//only believe a RST bearing exactly the sequence number we expect,
+	//answer the others with a challenge ACK (RFC 5961)
+	if(flags & RST)
+	{
+		if(seqn == esix_sockets[s].ackn)
+		{
+			esix_socket_lost(s);
+		}
+		else
+			esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
+		return;
+	}
 
-		break;
+	//same for a SYN in a synchronized state
+	if(flags & SYN)
+	{
+		esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
+		return;
+	}
 
-		case FIN:
-		case FIN|ACK:
-			if((session_sock = esix_find_socket(&ip_hdr->saddr, &ip_hdr->daddr, 
-				t_hdr->s_port, t_hdr->d_port, SOCK_STREAM, FIND_CONNECTED)) < 0)
-			{
-				esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-					ntoh32(t_hdr->ackn)+1, ntoh32(t_hdr->seqn)+1, RST|ACK, NULL, 0);
-				return;
-			}
+	//drop what we already have of a segment overlapping the window
+	if(SEQ_LT(seqn, esix_sockets[s].ackn))
+	{
+		data	+= esix_sockets[s].ackn - seqn;
+		dlen	-= esix_sockets[s].ackn - seqn;
+		seqn	= esix_sockets[s].ackn;
+	}
 
-			//remove every ack'ed packet from our send queue
-			esix_socket_expire_e(session_sock, ntoh32(t_hdr->ackn));
+	if(!(flags & ACK))
+		return;
 
-			//is the packet in order?
-			if(ntoh32(t_hdr->ackn) == esix_sockets[session_sock].seqn)
-			{
-				esix_sockets[session_sock].ackn += 1 ;
+	//our SYN|ACK is acknowledged
+	if(esix_sockets[s].state == SYN_RECEIVED)
+	{
+		if(ackn != esix_sockets[s].seqn)
+		{
+			esix_tcp_reset(t_hdr, ip_hdr, dlen);
+			return;
+		}
+		esix_sockets[s].state = ESTABLISHED;
+		esix_sockets[s].snd_una = esix_sockets[s].seqn;
+		esix_sockets[s].rexmit_high = esix_sockets[s].seqn;
+		esix_sockets[s].ecn_recover = esix_sockets[s].seqn;
+		esix_sockets[s].rexmits = 0;
+		esix_socket_keepalive(s);
+		esix_socket_wake(s);
+	}
+
+	//the peer can't acknowledge what we didn't send
+	if(SEQ_GT(ackn, esix_sockets[s].seqn))
+	{
+		esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
+		return;
+	}
 
-				switch(esix_sockets[session_sock].state)
-				{
-					case SYN_RECEIVED:
-					case ESTABLISHED:
-						esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-							esix_sockets[session_sock].seqn, esix_sockets[session_sock].ackn, FIN|ACK, NULL, 0);
-							esix_sockets[session_sock].seqn += 1 ;
+	//open the windows, then release what's acknowledged from the send ring
+	esix_tcp_ack_wnd(s, t_hdr);
+	esix_socket_expire(s, ackn);
 
-						esix_sockets[session_sock].state = FIN_WAIT_2;
-					break;
+	//the network is congested : react as to a loss, once per window.
+	//the ECE has to acknowledge data sent after the last reaction.
+	if((esix_sockets[s].flags & SOCK_ECN_OK) && (flags & ECE) &&
+		SEQ_GT(ackn, esix_sockets[s].ecn_recover))
+	{
+		esix_tcp_congestion(s, 0);
+		esix_sockets[s].ecn_recover = esix_sockets[s].seqn;
+		esix_sockets[s].flags |= SOCK_CWR;
+	}
 
-					case FIN_WAIT_1:
-						esix_tcp_send(&ip_hdr->daddr, &ip_hdr->saddr, t_hdr->d_port, t_hdr->s_port,
-							esix_sockets[session_sock].seqn, esix_sockets[session_sock].ackn, ACK, NULL, 0);
+	//update the SACK scoreboard and resend the holes it reveals
+	esix_tcp_process_options(s, t_hdr);
+	esix_socket_rexmit_holes(s, 0);
 
-						esix_socket_free_queue(session_sock);
-						esix_sockets[session_sock].state = CLOSED;
-					break;
-					default :
-					break;
-				}
-			}
-			
-		break;
+	//our FIN is acknowledged
+	if((esix_sockets[s].flags & SOCK_FIN_SENT) && ackn == esix_sockets[s].seqn)
+	{
+		switch(esix_sockets[s].state)
+		{
+			case FIN_WAIT_1:
+				//don't wait forever for the peer to close
+				esix_sockets[s].state = FIN_WAIT_2;
+				esix_sockets[s].rexmit_date = esix_get_time() + 2*ESIX_MSL;
+			break;
+			case CLOSING:
+				esix_socket_time_wait(s);
+			return;
+			case LAST_ACK:
+				esix_socket_release(s);
+			return;
+			default :
+			break;
+		}
+	}
 
-		case RST:
-		case RST|ACK:
-			if((session_sock = esix_find_socket(&ip_hdr->saddr, &ip_hdr->daddr, 
-				t_hdr->s_port, t_hdr->d_port, SOCK_STREAM, FIND_CONNECTED)) < 0)
-				return;
+	//what was held back might be allowed to leave now
+	esix_tcp_output(s, 0);
 
-			if(esix_sockets[session_sock].state != CLOSED)
-				esix_sockets[session_sock].state = CLOSED;
-			esix_socket_free_queue(session_sock);
-		break;
+	if(dlen > 0)
+	{
+		if(seqn != esix_sockets[s].ackn)
+		{
+			//future segment within our window : keep it (and SACK it) so
+			//that the peer only has to retransmit the missing part
+			if(SEQ_LEQ(seqn + dlen, esix_sockets[s].ackn + esix_tcp_rcv_wnd(s)) &&
+				esix_sockets[s].state == ESTABLISHED &&
+				esix_socket_queue_ooo(s, data, dlen, seqn) >= 0)
+				esix_sockets[s].sack_last = seqn;
+
+			esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
+			return;
+		}
+
+		switch(esix_sockets[s].state)
+		{
+			case ESTABLISHED:
+				//ACK right away if it fills a gap
+				ooo = esix_sockets[s].ooo_n > 0;
+
+				//grab it along with the out-of-order data it makes contiguous
+				if(esix_socket_queue_stream(s, data, dlen) < 0)
+					return;
+				if(!(flags & FIN))
+					esix_tcp_delay_ack(s, ooo || ce);
+			break;
+
+			case FIN_WAIT_1:
+			case FIN_WAIT_2:
+				//the socket was closed, nobody is going to read it.
+				//acknowledge it anyway so that the peer can close too.
+				esix_sockets[s].ackn += dlen;
+				if(!(flags & FIN))
+					esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
+			break;
+
+			default :
+				//the peer already sent its FIN
+			break;
+		}
+	}
+
+	if(!(flags & FIN))
+		return;
+
+	//a FIN past a hole has to wait for the retransmission
+	if(seqn + dlen != esix_sockets[s].ackn)
+	{
+		esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
+		return;
+	}
 
+	esix_sockets[s].ackn++;
+	esix_tcp_send_segment(s, esix_sockets[s].seqn, ACK, NULL, 0);
 
+	switch(esix_sockets[s].state)
+	{
+		case ESTABLISHED:
+			esix_sockets[s].state = CLOSE_WAIT;
+			esix_socket_raw_recv(s, NULL, 0, NULL);
+		break;
+		case FIN_WAIT_1:
+			esix_sockets[s].state = CLOSING;
+		break;
+		case FIN_WAIT_2:
+			esix_socket_time_wait(s);
+		break;
 		default :
-			//uh oh
-			uart_printf("esix_tcp_process : unknown flag %x \n", t_hdr->flags);
 		break;
 	}
+
+	//a blocked reader gets its end of file
+	esix_socket_wake(s);
 }
 
-void esix_tcp_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u16_t s_port, const u16_t d_port, 
-	const u32_t seqn, const u32_t ackn, const u8_t flags, const void *data, const u16_t len)
+/*
+ * Builds a SACK option out of the out-of-order segments of a socket.
+ * Returns the option length (0 if there's nothing to report).
+ */
+static int esix_tcp_build_sack(const int sock, u8_t *opts)
 {
-	int laddr;
-	struct tcp_hdr *hdr;
+	int i, n = esix_sockets[sock].ooo_n, first = 0, len;
+	struct esix_block *ooo = esix_sockets[sock].ooo;
 
-	//check source address
-	if((laddr = esix_intf_check_source_addr(saddr, daddr)) < 0)
-		return;	
+	if(n == 0)
+		return 0;
 
-	if((hdr = esix_w_malloc(sizeof(struct tcp_hdr) + len)) == NULL)
-		return;
-	
+	//the first block has to report the most recently received segment (RFC 2018)
+	for(i = 0; i < n; i++)
+		if(SEQ_GEQ(esix_sockets[sock].sack_last, ooo[i].left) &&
+			SEQ_LT(esix_sockets[sock].sack_last, ooo[i].right))
+			first = i;
+
+	opts[0] = TCP_OPT_NOP;
+	opts[1] = TCP_OPT_NOP;
+	opts[2] = TCP_OPT_SACK;
+	esix_tcp_put32(opts + 4, ooo[first].left);
+	esix_tcp_put32(opts + 8, ooo[first].right);
+	len = 12;
+
+	//then the others, as many as fit
+	for(i = 0; i < n && len < 4 + 8*TCP_MAX_SACK_BLOCKS; i++)
+	{
+		if(i == first)
+			continue;
+		esix_tcp_put32(opts + len, ooo[i].left);
+		esix_tcp_put32(opts + len + 4, ooo[i].right);
+		len += 8;
+	}
+	opts[3] = len - 2;
+
+	return len;
+}
+
+/*
+ * Writes a TCP header, options included.
+ */
+static void esix_tcp_fill(struct tcp_hdr *hdr, const u16_t s_port, const u16_t d_port,
+	const u32_t seqn, const u32_t ackn, const u8_t flags, const u16_t wnd,
+	const u8_t *opts, const u8_t opts_len)
+{
 	hdr->d_port = d_port;
 	hdr->s_port = s_port;
 	hdr->seqn = hton32(seqn);
 	hdr->ackn = hton32(ackn);
-	hdr->data_offset = (5 << 4); //we don't support any option yet...
+	hdr->data_offset = ((sizeof(struct tcp_hdr) + opts_len) / 4) << 4; //opts_len is a multiple of 4
 	hdr->flags = flags;
-	hdr->w_size = hton16(1400);
+	hdr->w_size = hton16(wnd);
 	hdr->urg_pointer = 0;
 	hdr->chksum = 0;
-	esix_memcpy(hdr + 1, data, len);
-	
-	hdr->chksum = esix_ip_upper_checksum(saddr, daddr, TCP, hdr, len + sizeof(struct tcp_hdr));
+	esix_memcpy(hdr + 1, opts, opts_len);
+}
 
-	esix_ip_send(saddr, daddr, DEFAULT_TTL, TCP, hdr, len + sizeof(struct tcp_hdr));
+/*
+ * Allocates a segment with room for len bytes of payload and fills in its
+ * header and options. Returns NULL if the source address can't be used or
+ * we're out of memory.
+ */
+static struct tcp_hdr *esix_tcp_build(const struct ip6_addr *saddr, const struct ip6_addr *daddr,
+	const u16_t s_port, const u16_t d_port, const u32_t seqn, const u32_t ackn, const u8_t flags,
+	const u16_t wnd, const u8_t *opts, const u8_t opts_len, const u16_t len)
+{
+	struct tcp_hdr *hdr;
+
+	//check source address
+	if(esix_intf_check_source_addr(saddr, daddr) < 0)
+		return NULL;
+
+	if((hdr = esix_w_malloc(sizeof(struct tcp_hdr) + opts_len + len)) == NULL)
+		return NULL;
+
+	esix_tcp_fill(hdr, s_port, d_port, seqn, ackn, flags, wnd, opts, opts_len);
+	return hdr;
+}
+
+/*
+ * Checksums a segment built by esix_tcp_build, sends it with traffic class
+ * tc and frees it.
+ */
+static void esix_tcp_xmit(const struct ip6_addr *saddr, const struct ip6_addr *daddr, struct tcp_hdr *hdr, const int len, const u8_t tc)
+{
+	hdr->chksum = esix_ip_upper_checksum(saddr, daddr, TCP, hdr, len);
+
+	esix_ip_send(saddr, daddr, DEFAULT_TTL, tc, TCP, hdr, len);
 
 	esix_w_free(hdr);
 }
 
+/*
+ * Sends a segment on a connected socket, along with the options
+ * it negotiated (MSS and SACK-permitted on SYNs, SACK blocks afterwards)
+ * and the room left in its receive ring as window. Without data, len
+ * bytes are taken from the send ring at seqn.
+ * With ECN, only new data is ECN-capable : not retransmissions, probes
+ * nor pure ACKs (RFC 3168 6.1.4 to 6.1.6).
+ */
+void esix_tcp_send_segment(const int sock, const u32_t seqn, u8_t flags, const void *data, const u16_t len)
+{
+	u8_t opts[TCP_MAX_OPT_LEN];
+	int opts_len = 0;
+	u16_t seg_len;
+	u32_t sum;
+	struct ip6_hdr *ip_hdr;
+	struct tcp_hdr *hdr;
+	u8_t *payload;
+	u8_t tc = ECN_NOT_ECT;
+
+	//always offer ECN on our SYN
+	if(flags == SYN)
+		flags |= ECE|CWR;
+	else if((esix_sockets[sock].flags & SOCK_ECN_OK) && !(flags & (SYN|RST)))
+	{
+		if(esix_sockets[sock].flags & SOCK_ECE)
+			flags |= ECE;
+
+		if(len > 0 && seqn == esix_sockets[sock].seqn)
+		{
+			tc = ECN_ECT0;
+			if(esix_sockets[sock].flags & SOCK_CWR)
+			{
+				flags |= CWR;
+				esix_sockets[sock].flags &= ~SOCK_CWR;
+			}
+		}
+	}
+
+	//this carries whatever ACK we were delaying
+	if(flags & ACK)
+	{
+		esix_sockets[sock].unacked_segs = 0;
+		esix_timer_stop(&esix_sockets[sock].delack_timer);
+	}
+
+	//always offer SACK, only accept it if the peer offered it
+	if(flags & SYN)
+		opts_len = esix_tcp_syn_opts(opts, !(flags & ACK) || (esix_sockets[sock].flags & SOCK_SACK_OK));
+	else if((esix_sockets[sock].flags & SOCK_SACK_OK) && !(flags & RST))
+		opts_len = esix_tcp_build_sack(sock, opts);
+
+	//the segment goes right behind the socket's IPv6 header
+	seg_len = sizeof(struct tcp_hdr) + opts_len + len;
+	if((ip_hdr = esix_ip_tmpl_packet(&esix_sockets[sock].tmpl, seg_len)) == NULL)
+		return;
+
+	hdr = (struct tcp_hdr *) (ip_hdr + 1);
+	esix_tcp_fill(hdr, esix_sockets[sock].lport, esix_sockets[sock].rport, seqn,
+		esix_sockets[sock].ackn, flags, esix_tcp_rcv_wnd(sock), opts, opts_len);
+
+	payload = (u8_t *) (hdr + 1) + opts_len;
+	if(data != NULL)
+		esix_memcpy(payload, data, len);
+	else if(len > 0)
+		esix_socket_snd_get(sock, seqn, payload, len);
+
+	//the oldest segment in flight is the one timeouts and fast retransmit
+	//resend : keep the sum of its payload, only its header changes.
+	if(data == NULL && len > 0 && seqn == esix_sockets[sock].snd_una)
+	{
+		if(esix_sockets[sock].rtx_len != len || esix_sockets[sock].rtx_seqn != seqn)
+		{
+			esix_sockets[sock].rtx_seqn = seqn;
+			esix_sockets[sock].rtx_len = len;
+			esix_sockets[sock].rtx_sum = esix_ip_sum(0, payload, len);
+		}
+		sum = esix_ip_sum(esix_sockets[sock].tmpl.sum + hton16(seg_len), hdr, seg_len - len);
+		hdr->chksum = esix_ip_fold_checksum(sum + esix_sockets[sock].rtx_sum);
+	}
+	else
+		hdr->chksum = esix_ip_finish_checksum(esix_sockets[sock].tmpl.sum, hdr, seg_len);
+
+	esix_ip_tmpl_send(&esix_sockets[sock].tmpl, ip_hdr, tc);
+}
+
+void esix_tcp_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u16_t s_port, const u16_t d_port, 
+	const u32_t seqn, const u32_t ackn, const u8_t flags, const void *data, const u16_t len)
+{
+	esix_tcp_send_opts(saddr, daddr, s_port, d_port, seqn, ackn, flags, 0, NULL, 0, data, len);
+}
+
+void esix_tcp_send_opts(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u16_t s_port, const u16_t d_port, 
+	const u32_t seqn, const u32_t ackn, const u8_t flags, const u16_t wnd, const u8_t *opts, const u8_t opts_len,
+	const void *data, const u16_t len)
+{
+	struct tcp_hdr *hdr;
+
+	if((hdr = esix_tcp_build(saddr, daddr, s_port, d_port, seqn, ackn, flags, wnd, opts, opts_len, len)) == NULL)
+		return;
+
+	esix_memcpy((u8_t *) (hdr + 1) + opts_len, data, len);
+	
+	esix_tcp_xmit(saddr, daddr, hdr, len + opts_len + sizeof(struct tcp_hdr), 0);
+}
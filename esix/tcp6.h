@@ -39,6 +39,28 @@
 	#define SYN (1 << 1)
 	#define FIN (1 << 0)
 
+	//TCP option kinds
+	#define TCP_OPT_EOL		0
+	#define TCP_OPT_NOP		1
+	#define TCP_OPT_MSS		2
+	#define TCP_OPT_SACK_PERM	4
+	#define TCP_OPT_SACK		5
+
+	#define TCP_DEFAULT_MSS		1220 //IPv6 minimum MTU - headers (RFC 9293)
+	#define TCP_LOCAL_MSS		(DEFAULT_MTU - 60) //what we advertise : our MTU - headers
+	#define TCP_INIT_CWND(mss)	((mss) > 2190 ? 2*(mss) : ((mss) > 1095 ? 3*(mss) : 4*(mss))) //RFC 3390
+	#define TCP_MAX_OPT_LEN		40
+	#define TCP_MAX_SACK_BLOCKS	4 //what fits in 40 bytes of options
+	#define TCP_DUPTHRESH		3 //SACKed blocks above a hole to deem it lost (RFC 6675)
+	#define TCP_SYNACK_RETRIES	3 //SYN|ACK retransmissions before dropping a half-open connection
+	#define TCP_MAX_BACKOFF		6 //retransmission timeouts double up to 2s << 6
+
+	//sequence number comparisons (modulo 2^32)
+	#define SEQ_LT(a, b)	((int) ((a) - (b)) < 0)
+	#define SEQ_LEQ(a, b)	((int) ((a) - (b)) <= 0)
+	#define SEQ_GT(a, b)	((int) ((a) - (b)) > 0)
+	#define SEQ_GEQ(a, b)	((int) ((a) - (b)) >= 0)
+
 	struct tcp_hdr
 	{
 		u16_t s_port;	
@@ -63,5 +85,18 @@
 	void esix_tcp_process(const struct tcp_hdr *t_hdr, const int len, const struct ip6_hdr *ip_hdr);
 	void esix_tcp_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u16_t s_port, 
 		const u16_t d_port, const u32_t	seqn, const u32_t ackn, const u8_t flags, const void *data, const u16_t len);
+	void esix_tcp_send_opts(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u16_t s_port,
+		const u16_t d_port, const u32_t seqn, const u32_t ackn, const u8_t flags, const u16_t wnd,
+		const u8_t *opts, const u8_t opts_len, const void *data, const u16_t len);
+	void esix_tcp_send_segment(const int sock, const u32_t seqn, u8_t flags, const void *data, const u16_t len);
+	void esix_tcp_process_options(const int sock, const struct tcp_hdr *t_hdr);
+	void esix_tcp_delack_timeout(int sock);
+	void esix_tcp_output(int sock, int push);
+	void esix_tcp_window_update(int sock, u16_t wnd);
+	void esix_tcp_cork_timeout(int sock);
+	void esix_tcp_congestion(int sock, int timeout);
+	u16_t esix_tcp_seg_size(int sock);
+	u8_t esix_tcp_ctl_unacked(int sock);
+	void esix_tcp_send_synack(int syn);
 		
 #endif
@@ -0,0 +1,121 @@
+/**
+ * @file
+ * Sub-second timers.
+ *
+ * @section LICENSE
+ * Copyright (c) 2009, Floris Chabert, Simon Vetter. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AS IS'' AND ANY EXPRESS 
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO 
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO,PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR  
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS  SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "timer.h"
+#include "tools.h"
+#include "include/esix.h"
+
+//pending timers, sorted by expiration date
+static struct esix_timer *timers;
+static u32_t current_ms;
+
+u32_t esix_get_time_ms()
+{
+	return current_ms;
+}
+
+/*
+ * Sets up a timer. Must be called once before any other operation on it.
+ */
+void esix_timer_init(struct esix_timer *t, void (*handler)(int), int arg)
+{
+	t->handler	= handler;
+	t->arg		= arg;
+	t->pending	= 0;
+	t->next		= NULL;
+}
+
+/*
+ * (Re)arms a timer to fire in delay ms.
+ */
+void esix_timer_start(struct esix_timer *t, u32_t delay)
+{
+	struct esix_timer **cur;
+
+	esix_timer_stop(t);
+	t->date		= current_ms + delay;
+	t->pending	= 1;
+
+	//keep the list sorted so that the tick only looks at its head
+	cur = &timers;
+	while(*cur != NULL && (int) ((*cur)->date - t->date) <= 0)
+		cur = &(*cur)->next;
+
+	t->next	= *cur;
+	*cur	= t;
+}
+
+void esix_timer_stop(struct esix_timer *t)
+{
+	struct esix_timer **cur;
+
+	if(!t->pending)
+		return;
+
+	for(cur = &timers; *cur != NULL; cur = &(*cur)->next)
+	{
+		if(*cur == t)
+		{
+			*cur = t->next;
+			break;
+		}
+	}
+	t->pending = 0;
+}
+
+int esix_timer_pending(const struct esix_timer *t)
+{
+	return t->pending;
+}
+
+/*
+ * esix_tick_ms : the period esix_tick_callback() has to be called at.
+ */
+u16_t esix_tick_ms(void)
+{
+	return ESIX_TICK_MS;
+}
+
+/*
+ * esix_tick_callback : must be called every ESIX_TICK_MS ms by the OS.
+ */
+void esix_tick_callback()
+{
+	struct esix_timer *t;
+
+	current_ms += ESIX_TICK_MS;
+
+	while(timers != NULL && (int) (timers->date - current_ms) <= 0)
+	{
+		//unlink it first, the handler might want to rearm it
+		t	= timers;
+		timers	= t->next;
+		t->pending = 0;
+		t->handler(t->arg);
+	}
+}
@@ -0,0 +1,50 @@
+/**
+ * @file
+ * Sub-second timers.
+ *
+ * @section LICENSE
+ * Copyright (c) 2009, Floris Chabert, Simon Vetter. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *    * Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AS IS'' AND ANY EXPRESS 
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO 
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO,PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR  
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS  SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+	#include "config.h"
+
+	/**
+	 * One-shot timer, to be embedded in the structure it works for.
+	 */
+	struct esix_timer
+	{
+		u32_t date; //date (in ms) at which the timer fires
+		void (*handler)(int); //called upon expiration
+		int arg; //handler argument
+		u8_t pending; //set while the timer is in the list
+		struct esix_timer *next; //next pending timer
+	};
+
+	void esix_timer_init(struct esix_timer *, void (*)(int), int);
+	void esix_timer_start(struct esix_timer *, u32_t);
+	void esix_timer_stop(struct esix_timer *);
+	int esix_timer_pending(const struct esix_timer *);
+	u32_t esix_get_time_ms();
+#endif
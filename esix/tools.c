@@ -64,6 +64,124 @@ int esix_memcmp(const void *p1, const void *p2, int len)
 	return 0;
 }
 
+/*
+ * Jenkins one-at-a-time hash of len bytes.
+ */
+u32_t esix_hash(const void *data, int len, u32_t seed)
+{
+	const u8_t *p = data;
+	u32_t h = seed;
+
+	while(len--)
+	{
+		h += *p++;
+		h += h << 10;
+		h ^= h >> 6;
+	}
+	h += h << 3;
+	h ^= h >> 11;
+	h += h << 15;
+	return h;
+}
+
+/*
+ * Copies len bytes in a ring, off bytes past its head. Doesn't change
+ * what the ring holds : off + len must fit in its size.
+ */
+void esix_ring_put(struct esix_ring *r, int off, const void *data, int len)
+{
+	int pos = (r->head + off) % r->size;
+	int n = r->size - pos;
+
+	if(n > len)
+		n = len;
+	esix_memcpy(r->buf + pos, data, n);
+	esix_memcpy(r->buf, (const u8_t *) data + n, len - n);
+}
+
+/*
+ * Copies len bytes out of a ring, off bytes past its head.
+ */
+void esix_ring_get(const struct esix_ring *r, int off, void *buf, int len)
+{
+	int pos = (r->head + off) % r->size;
+	int n = r->size - pos;
+
+	if(n > len)
+		n = len;
+	esix_memcpy(buf, r->buf + pos, n);
+	esix_memcpy((u8_t *) buf + n, r->buf, len - n);
+}
+
+/*
+ * Appends as much as fits of len bytes. Returns the number of bytes written.
+ */
+int esix_ring_write(struct esix_ring *r, const void *data, int len)
+{
+	if(len > r->size - r->len)
+		len = r->size - r->len;
+	if(len <= 0)
+		return 0;
+
+	esix_ring_put(r, r->len, data, len);
+	r->len += len;
+	return len;
+}
+
+/*
+ * Takes up to len bytes out of a ring. Returns the number of bytes read.
+ */
+int esix_ring_read(struct esix_ring *r, void *buf, int len)
+{
+	if(len > r->len)
+		len = r->len;
+	if(len <= 0)
+		return 0;
+
+	esix_ring_get(r, 0, buf, len);
+	esix_ring_drop(r, len);
+	return len;
+}
+
+/*
+ * Discards the first len bytes of a ring.
+ */
+void esix_ring_drop(struct esix_ring *r, int len)
+{
+	if(len > r->len)
+		len = r->len;
+	if(len <= 0)
+		return;
+
+	r->len -= len;
+	r->head = (r->head + len) % r->size;
+}
+
+static u32_t random_state = 0x2545f491;
+
+/*
+ * Mixes some entropy (link-layer address, peer ISNs...) into the
+ * pseudo-random generator.
+ */
+void esix_random_stir(u32_t v)
+{
+	random_state = esix_hash(&v, sizeof(v), random_state);
+	if(random_state == 0)
+		random_state = 0x2545f491;
+}
+
+/*
+ * xorshift32 pseudo-random generator. Not cryptographically strong,
+ * but enough to make ISNs, ports and SYN cookies hard to guess.
+ */
+u32_t esix_random(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
 /**
  * hton16 : converts host endianess to big endian (network order) 
  */
@@ -33,8 +33,25 @@
 
 #define NULL ((void *) 0)
 
+//circular byte buffer : len bytes starting at head, wrapping at size
+struct esix_ring
+{
+	u8_t *buf;
+	u16_t size;
+	u16_t head;
+	u16_t len;
+};
+
 void esix_memcpy(void *dst, const void *src, int len);
 int esix_memcmp(const void *p1, const void *p2, int len);
+u32_t esix_hash(const void *data, int len, u32_t seed);
+void esix_random_stir(u32_t v);
+u32_t esix_random(void);
+void esix_ring_put(struct esix_ring *r, int off, const void *data, int len);
+void esix_ring_get(const struct esix_ring *r, int off, void *buf, int len);
+int esix_ring_write(struct esix_ring *r, const void *data, int len);
+int esix_ring_read(struct esix_ring *r, void *buf, int len);
+void esix_ring_drop(struct esix_ring *r, int len);
 
 inline u16_t hton16(u16_t v);
 inline u32_t hton32(u32_t v);
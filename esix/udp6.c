@@ -49,19 +49,28 @@ void esix_udp_process(const struct udp_hdr *u_hdr, int len, const struct ip6_hdr
 	if(esix_ip_upper_checksum(&ip_hdr->saddr, &ip_hdr->daddr, UDP, u_hdr, len) != 0)
 		return;
 
+	esix_memcpy(&sockaddr.sin6_addr, &ip_hdr->saddr, 16);
+	sockaddr.sin6_port = u_hdr->s_port;
+
+	//multicast : every socket listening to the group gets it
+	if((ip_hdr->daddr.addr1 & hton32(0xff000000)) == hton32(0xff000000))
+	{
+		esix_queue_mcast(&ip_hdr->daddr, u_hdr->d_port, u_hdr+1,
+			ntoh16(u_hdr->len)-sizeof(struct udp_hdr), &sockaddr);
+		return;
+	}
+
 	if((sock = esix_find_socket(&ip_hdr->saddr, &ip_hdr->daddr, u_hdr->s_port, u_hdr->d_port, 
-		UDP, FIND_LISTEN)) < 0)
+		UDP, FIND_ANY)) < 0)
 	{
 		uart_printf("esix_udp_process : port unreachable\n");
-		//don't send port unreach in response to multicasts
-		if( (ip_hdr->daddr.addr1 & hton32(0xff000000)) != hton32(0xff000000))
-			esix_icmp_send_unreachable(ip_hdr, PORT_UNREACHABLE); 	
+		esix_icmp_send_unreachable(ip_hdr, PORT_UNREACHABLE); 	
 		return;
 	}
 
-	esix_memcpy(&sockaddr.sin6_addr, &ip_hdr->saddr, 16);
-	sockaddr.sin6_port = u_hdr->s_port;
-	esix_queue_data(sock, u_hdr+1, ntoh16(u_hdr->len)-sizeof(struct udp_hdr), &sockaddr, IN);
+	//raw API sockets get it right out of the packet
+	if(esix_socket_raw_recv(sock, u_hdr+1, ntoh16(u_hdr->len)-sizeof(struct udp_hdr), &sockaddr) < 0)
+		esix_queue_data(sock, u_hdr+1, ntoh16(u_hdr->len)-sizeof(struct udp_hdr), &sockaddr);
 
 	return;
 }
@@ -80,7 +89,31 @@ void esix_udp_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, u
 
 	hdr->chksum = esix_ip_upper_checksum(saddr, daddr, UDP, hdr, len + sizeof(struct udp_hdr));
 	
-	esix_ip_send(saddr, daddr, DEFAULT_TTL, UDP, hdr, len + sizeof(struct udp_hdr));
+	esix_ip_send(saddr, daddr, DEFAULT_TTL, 0, UDP, hdr, len + sizeof(struct udp_hdr));
 
 	esix_w_free(hdr);
 }
+
+/*
+ * Sends a datagram out of a packet template. Returns -1 if it couldn't go.
+ */
+int esix_udp_send_tmpl(struct esix_ip_tmpl *t, u16_t s_port, u16_t d_port, const void *data, u16_t len)
+{
+	struct ip6_hdr *ip;
+	struct udp_hdr *hdr;
+
+	if((ip = esix_ip_tmpl_packet(t, len + sizeof(struct udp_hdr))) == NULL)
+		return -1;
+
+	hdr = (struct udp_hdr *) (ip + 1);
+	hdr->d_port = d_port;
+	hdr->s_port = s_port;
+	hdr->len = hton16(len + sizeof(struct udp_hdr));
+	hdr->chksum = 0;
+	esix_memcpy(hdr + 1, data, len);
+
+	hdr->chksum = esix_ip_finish_checksum(t->sum, hdr, len + sizeof(struct udp_hdr));
+
+	esix_ip_tmpl_send(t, ip, 0);
+	return 0;
+}
@@ -54,5 +54,6 @@
 	void esix_udp_process(const struct udp_hdr *u_hdr, int len, const struct ip6_hdr *ip_hdr);
 	void esix_udp_send(const struct ip6_addr *saddr, const struct ip6_addr *daddr, const u16_t s_port, 
 		const u16_t d_port, const void *data, const u16_t len);
+	int esix_udp_send_tmpl(struct esix_ip_tmpl *t, u16_t s_port, u16_t d_port, const void *data, u16_t len);
 
 #endif